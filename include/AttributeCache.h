@@ -0,0 +1,158 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+
+/**
+ * AttributeCache
+ *
+ * Last known ThingsBoard shared attributes (systemConfig, telemetry settings),
+ * kept on LittleFS so the controller can apply them at boot before the
+ * network is up, and only act again when the broker sends something new.
+ *
+ * File layout (little-endian):
+ *   Header { magic "TTAC", format version, payload length, generation, CRC32 }
+ *   Payload: the attributes object as MessagePack
+ *
+ * The generation counts saves, so logs show which snapshot a boot ran from.
+ * A file with a wrong magic, version, length or CRC is ignored.
+ */
+
+class AttributeCache {
+public:
+  explicit AttributeCache(const char* path = "/attr_cache.bin")
+    : m_path(path), m_doc(DOC_SIZE) {
+    m_doc.to<JsonObject>();
+  }
+
+  // Read the cache file. Returns false if it's missing or corrupted.
+  bool load() {
+    m_loaded = false;
+    File f = LittleFS.open(m_path, "r");
+    if (!f) {
+      Serial.println("[AttrCache] No cache file");
+      return false;
+    }
+
+    Header header;
+    if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != MAGIC || header.version != FORMAT_VERSION || header.length > MAX_PAYLOAD) {
+      Serial.println("[AttrCache] Bad header, ignoring cache");
+      f.close();
+      return false;
+    }
+
+    uint8_t payload[MAX_PAYLOAD];
+    size_t n = f.read(payload, header.length);
+    f.close();
+    if (n != header.length || crc32(payload, n) != header.crc) {
+      Serial.println("[AttrCache] CRC mismatch, ignoring cache");
+      return false;
+    }
+
+    DeserializationError err = deserializeMsgPack(m_doc, payload, n);
+    if (err || !m_doc.is<JsonObject>()) {
+      Serial.printf("[AttrCache] Decode failed: %s\n", err.c_str());
+      m_doc.to<JsonObject>();
+      return false;
+    }
+
+    m_generation = header.generation;
+    m_loaded = true;
+    Serial.printf("[AttrCache] Loaded generation %lu (%u bytes)\n", m_generation, (unsigned)n);
+    return true;
+  }
+
+  // Write the cache atomically (temp file + rename)
+  bool save() {
+    uint8_t payload[MAX_PAYLOAD];
+    size_t n = serializeMsgPack(m_doc, payload, sizeof(payload));
+    if (n == 0 || n >= sizeof(payload)) {
+      Serial.println("[AttrCache] Attributes too large to cache");
+      return false;
+    }
+
+    Header header;
+    header.magic = MAGIC;
+    header.version = FORMAT_VERSION;
+    header.length = (uint16_t)n;
+    header.generation = m_generation + 1;
+    header.crc = crc32(payload, n);
+
+    String tmpPath = String(m_path) + ".tmp";
+    File f = LittleFS.open(tmpPath, "w");
+    if (!f) {
+      Serial.println("[AttrCache] Failed to open cache file for writing");
+      return false;
+    }
+    bool ok = f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+              f.write(payload, n) == n;
+    f.close();
+
+    if (!ok) {
+      Serial.println("[AttrCache] Write failed");
+      LittleFS.remove(tmpPath);
+      return false;
+    }
+    LittleFS.remove(m_path);
+    if (!LittleFS.rename(tmpPath, m_path)) {
+      Serial.println("[AttrCache] Rename failed");
+      return false;
+    }
+
+    m_generation = header.generation;
+    Serial.printf("[AttrCache] Saved generation %lu (%u bytes)\n", m_generation, (unsigned)n);
+    return true;
+  }
+
+  // Store a value. Returns true if it differs from the cached one.
+  bool update(const char* key, JsonVariantConst value) {
+    JsonVariantConst current = m_doc[key];
+    if (!current.isNull()) {
+      String a, b;
+      serializeJson(current, a);
+      serializeJson(value, b);
+      if (a == b) return false;
+    }
+    m_doc[key] = value;
+    return true;
+  }
+
+  JsonObjectConst values() const { return m_doc.as<JsonObjectConst>(); }
+  bool isLoaded() const { return m_loaded; }
+  uint32_t generation() const { return m_generation; }
+
+  void printStatus() const {
+    Serial.printf("[AttrCache] %s, generation %lu: ", m_loaded ? "loaded" : "not loaded", m_generation);
+    serializeJson(m_doc, Serial);
+    Serial.println();
+  }
+
+private:
+  static constexpr uint32_t MAGIC = 0x43415454;  // "TTAC"
+  static constexpr uint16_t FORMAT_VERSION = 1;
+  static constexpr size_t MAX_PAYLOAD = 768;
+  static constexpr size_t DOC_SIZE = 1024;
+
+  struct __attribute__((packed)) Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t generation;
+    uint32_t crc;
+  };
+
+  const char* m_path;
+  DynamicJsonDocument m_doc;
+  uint32_t m_generation = 0;
+  bool m_loaded = false;
+
+  static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; ++i) {
+      crc ^= data[i];
+      for (int b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+  }
+};
@@ -2,40 +2,158 @@
 
 #include <OneWire.h>
 #include <DallasTemperature.h>
-#include <map>
 #include <array>
+#include "SensorRegistry.h"
 
 class DallasManager {
 public:
   using DeviceAddress = std::array<uint8_t, 8>;
 
+  // Index of a registered sensor (and its SensorRegistry channel); names are
+  // only looked up while configuring, reads by handle don't allocate or compare
+  using Handle = uint8_t;
+  static constexpr Handle INVALID_HANDLE = 0xFF;
+  static constexpr uint8_t MAX_SENSORS = 16;
+
   DallasManager(uint8_t pin) : m_oneWire(pin), m_sensors(&m_oneWire) {}
 
   void begin() {
     Serial.println("[DallasManager] Initializing sensors...");
     m_sensors.begin();
     Serial.printf("[DallasManager] Found %d sensors on bus.\n", m_sensors.getDeviceCount());
+    m_begun = true;
+    for (Handle h = 0; h < m_count; ++h) applyResolution(m_slots[h]);
+    updateConversionTime();
   }
 
-  void addSensor(const String& name, const DeviceAddress& addr) {
-    m_sensorsMap[name] = addr;
+  // resolution: 9..12 bits, trading precision (0.5 .. 0.0625 C) for conversion time (94 .. 750 ms).
+  // Registering a name again updates that sensor and returns its handle.
+  Handle addSensor(const String& name, const DeviceAddress& addr, uint8_t resolution = 12) {
+    Handle h = findSensor(name);
+    if (h == INVALID_HANDLE) {
+      if (m_count >= MAX_SENSORS) {
+        Serial.printf("[DallasManager] No room for '%s' (max %u sensors)\n", name.c_str(), MAX_SENSORS);
+        return INVALID_HANDLE;
+      }
+      h = m_count++;
+      m_slots[h] = Sensor();
+      m_slots[h].name = name;
+    }
+    m_slots[h].addr = addr;
+    setResolution(h, resolution);
+    return h;
   }
 
-  float getTemperature(const String& name) {
-    auto it = m_sensorsMap.find(name);
-    if (it == m_sensorsMap.end()) {
-      Serial.printf("[DallasManager] Sensor '%s' not found!\n", name.c_str());
-      return NAN;
+  Handle findSensor(const String& name) const {
+    for (Handle h = 0; h < m_count; ++h) {
+      if (m_slots[h].name == name) return h;
     }
-    const DeviceAddress& addr = it->second;
+    return INVALID_HANDLE;
+  }
+
+  const String& sensorName(Handle h) const { return m_slots[h < m_count ? h : 0].name; }
+
+  bool setResolution(Handle h, uint8_t resolution) {
+    if (h >= m_count) return false;
+    m_slots[h].resolution = constrain(resolution, 9, 12);
+    if (m_begun) applyResolution(m_slots[h]);
+    updateConversionTime();
+    return true;
+  }
+
+  bool setResolution(const String& name, uint8_t resolution) { return setResolution(findSensor(name), resolution); }
+
+  // Time one bus-wide conversion takes: set by the highest resolution on the bus
+  unsigned long getConversionTimeMs() const { return m_conversionMs; }
+
+  // Non-blocking sampling: start a conversion on the whole bus every m_intervalMs,
+  // wait for its end, then fetch one sensor's scratchpad per call. Externally
+  // powered sensors report the end (polled); on a parasite-powered bus the line
+  // reads high during a conversion, so the full conversion time is waited out.
+  void tick() {
+    unsigned long now = millis();
+    switch (m_state) {
+      case State::IDLE:
+        if (!m_count || (m_lastConversionMs && now - m_lastConversionMs < m_intervalMs)) return;
+        m_sensors.setWaitForConversion(false);
+        m_sensors.requestTemperatures();
+        m_sensors.setWaitForConversion(true); // getTemperature() stays blocking
+        m_conversionStartMs = now;
+        m_state = State::CONVERTING;
+        break;
+
+      case State::CONVERTING:
+        if (now - m_conversionStartMs < m_conversionMs &&
+            (m_sensors.isParasitePowerMode() || !m_sensors.isConversionComplete())) return;
+        m_readIndex = 0;
+        m_state = State::READING;
+        break;
+
+      case State::READING: {
+        Sensor& sensor = m_slots[m_readIndex];
+        float temp = m_sensors.getTempC(sensor.addr.data());
+        if (temp != DEVICE_DISCONNECTED_C) {
+          sensor.temp = temp;
+          sensor.readMs = now;
+        }
+        if (++m_readIndex >= m_count) {
+          m_lastConversionMs = m_conversionStartMs ? m_conversionStartMs : 1;
+          m_state = State::IDLE;
+        }
+        break;
+      }
+    }
+  }
+
+  void setReadInterval(unsigned long intervalMs) {
+    m_requestedIntervalMs = intervalMs;
+    m_intervalMs = intervalMs > m_conversionMs ? intervalMs : m_conversionMs;
+  }
+  size_t sensorCount() const { return m_count; }
+
+  // Last value from tick() sampling, false if there's none within the expiry time
+  bool readChannel(Handle h, float& value, uint32_t& readMs) const {
+    return getCachedTemperature(h, value, readMs) && millis() - readMs <= 3 * m_intervalMs;
+  }
+
+  // Last value from tick() sampling, with the millis() it was read at
+  bool getCachedTemperature(Handle h, float& temp, uint32_t& readMs) const {
+    if (h >= m_count || !m_slots[h].readMs) return false;
+    temp = m_slots[h].temp;
+    readMs = m_slots[h].readMs;
+    return true;
+  }
+
+  bool getCachedTemperature(const String& name, float& temp, uint32_t& readMs) const {
+    return getCachedTemperature(findSensor(name), temp, readMs);
+  }
+
+  // Served from the tick() cache while it's fresh; otherwise a blocking
+  // conversion of this sensor alone (up to its conversion time)
+  float getTemperature(Handle h) {
+    if (h >= m_count) return NAN;
+    float temp;
+    uint32_t readMs;
+    if (readChannel(h, temp, readMs)) return temp;
+
+    const DeviceAddress& addr = m_slots[h].addr;
     m_sensors.requestTemperaturesByAddress(addr.data());
-    float temp = m_sensors.getTempC(addr.data());
+    temp = m_sensors.getTempC(addr.data());
     if (isnan(temp)) {
-      Serial.printf("[DallasManager] Failed to read '%s'\n", name.c_str());
+      Serial.printf("[DallasManager] Failed to read '%s'\n", m_slots[h].name.c_str());
     }
     return temp;
   }
 
+  float getTemperature(const String& name) {
+    Handle h = findSensor(name);
+    if (h == INVALID_HANDLE) {
+      Serial.printf("[DallasManager] Sensor '%s' not found!\n", name.c_str());
+      return NAN;
+    }
+    return getTemperature(h);
+  }
+
   void scanAndPrint() {
     Serial.println("[DallasManager] Scanning OneWire bus...");
     DeviceAddress addr;
@@ -60,7 +178,75 @@ private:
     }
   }
 
+  struct Sensor {
+    String name;
+    DeviceAddress addr{};
+    uint8_t resolution = 12;
+    float temp = NAN;         // last tick() reading
+    uint32_t readMs = 0;
+  };
+
+  // DS18B20 conversion time halves with every bit less: 750 ms at 12 bits, 94 ms at 9
+  static unsigned long conversionTimeMs(uint8_t resolution) {
+    return 750UL >> (12 - resolution);
+  }
+
+  void applyResolution(const Sensor& sensor) {
+    // Keep the library's global resolution alone, updateConversionTime() does the bus-wide part
+    if (!m_sensors.setResolution(sensor.addr.data(), sensor.resolution, true)) {
+      Serial.printf("[DallasManager] Failed to set %u-bit resolution on '%s'\n", sensor.resolution, sensor.name.c_str());
+    }
+  }
+
+  void updateConversionTime() {
+    uint8_t highest = 9;
+    for (Handle h = 0; h < m_count; ++h) {
+      if (m_slots[h].resolution > highest) highest = m_slots[h].resolution;
+    }
+    m_conversionMs = conversionTimeMs(highest);
+    setReadInterval(m_requestedIntervalMs);
+  }
+
+  enum class State : uint8_t { IDLE, CONVERTING, READING };
+
   OneWire m_oneWire;
   DallasTemperature m_sensors;
-  std::map<String, DeviceAddress> m_sensorsMap;
+  Sensor m_slots[MAX_SENSORS];              // handle -> sensor, in addSensor() order
+  uint8_t m_count = 0;
+
+  State m_state = State::IDLE;
+  bool m_begun = false;
+  unsigned long m_conversionMs = 750;
+  unsigned long m_requestedIntervalMs = 60000;
+  unsigned long m_intervalMs = 60000;
+  unsigned long m_conversionStartMs = 0;
+  unsigned long m_lastConversionMs = 0;
+  size_t m_readIndex = 0;
+};
+
+// SensorRegistry adapter: channel = sensor handle (addSensor() order), temperature only
+class DallasSensorSource : public SensorSource {
+public:
+  explicit DallasSensorSource(DallasManager& manager, const char* name = "onewire")
+    : m_manager(manager), m_name(name) {}
+
+  const char* name() const override { return m_name; }
+  void tick() override { m_manager.tick(); }
+
+  bool read(uint16_t channel, SensorQuantity quantity, float& value, uint32_t& readMs) const override {
+    if (quantity != SensorQuantity::Temperature || channel >= m_manager.sensorCount()) return false;
+    return m_manager.readChannel((DallasManager::Handle)channel, value, readMs);
+  }
+
+  // One conversion serves the whole bus, so the fastest channel sets the pace
+  void setInterval(uint16_t channel, uint32_t intervalMs) override {
+    (void)channel;
+    if (!m_intervalMs || intervalMs < m_intervalMs) m_intervalMs = intervalMs;
+    m_manager.setReadInterval(m_intervalMs);
+  }
+
+private:
+  DallasManager& m_manager;
+  const char* m_name;
+  uint32_t m_intervalMs = 0;
 };
@@ -0,0 +1,232 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <functional>
+#include <sys/time.h>
+
+/**
+ * LogManager
+ *
+ * Leveled log pipeline for remote log shipping.
+ * log() only formats the line into a fixed slot of a lock-free ring buffer,
+ * so it is cheap and safe to call from any task. tick() drains the ring in
+ * the loop task and packs the pending lines into one ThingsBoard telemetry
+ * array ([{"ts":..,"values":{"log":..,"level":..}}, ...]) per batch.
+ *
+ * Each module (the "[Tag]" prefix of a message) can have its own minimum
+ * level; lines below it are filtered before they reach the ring.
+ * Lines that don't fit in the ring are counted in getDropped().
+ */
+
+enum class LogLevel : uint8_t {
+  Debug = 0,
+  Info = 1,
+  Warn = 2,
+  Error = 3,
+  None = 4
+};
+
+class LogManager {
+public:
+  using BatchSink = std::function<void(const JsonDocument& batch)>;
+
+  LogManager() {
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+      m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  void setSink(BatchSink sink) { m_sink = sink; }
+
+  // Lock-free, multi-producer. Returns false if filtered or dropped.
+  bool log(LogLevel level, const String& message) {
+    char module[MODULE_LEN];
+    moduleOf(message, module, sizeof(module));
+    if (level < getModuleLevel(module)) return false;
+
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &m_slots[pos & (RING_SIZE - 1)];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);  // ring is full
+        return false;
+      } else {
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->level = level;
+    slot->epochMs = epochMs();
+    strlcpy(slot->text, message.c_str(), sizeof(slot->text));
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Call every loop - ships a batch when it's full or FLUSH_INTERVAL_MS passed
+  void tick() {
+    size_t pending = m_enqueuePos.load(std::memory_order_relaxed) - m_dequeuePos;
+    unsigned long now = millis();
+    if (pending == 0 && m_dropped.load(std::memory_order_relaxed) == m_reportedDropped) return;
+    if (pending < BATCH_LINES && now - m_lastFlush < FLUSH_INTERVAL_MS) return;
+
+    m_lastFlush = now;
+    drain();
+  }
+
+  // Pack and ship everything pending right now
+  void drain() {
+    DynamicJsonDocument batch(BATCH_DOC_SIZE);
+    JsonArray entries = batch.to<JsonArray>();
+    size_t bytes = 0;
+
+    while (bytes < BATCH_MAX_BYTES) {
+      Slot& slot = m_slots[m_dequeuePos & (RING_SIZE - 1)];
+      size_t seq = slot.seq.load(std::memory_order_acquire);
+      if ((intptr_t)seq - (intptr_t)(m_dequeuePos + 1) < 0) break;  // nothing committed here
+
+      JsonObject entry = entries.createNestedObject();
+      if (slot.epochMs) entry["ts"] = slot.epochMs;
+      JsonObject values = entry.createNestedObject("values");
+      values["log"] = slot.text;
+      values["level"] = levelToString(slot.level);
+      bytes += strlen(slot.text) + ENTRY_OVERHEAD_BYTES;
+
+      slot.seq.store(m_dequeuePos + RING_SIZE, std::memory_order_release);
+      m_dequeuePos++;
+    }
+
+    uint32_t dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDropped) {
+      JsonObject entry = entries.createNestedObject();
+      entry["log_dropped"] = dropped;
+      m_reportedDropped = dropped;
+    }
+
+    if (entries.size() > 0 && m_sink) m_sink(batch);
+  }
+
+  // ==== Runtime level filters ====
+  // module "*" sets the default level for modules without their own filter
+  void setModuleLevel(const String& module, LogLevel level) {
+    if (module == "*") {
+      m_defaultLevel = level;
+      return;
+    }
+    int freeIdx = -1;
+    for (int i = 0; i < MAX_FILTERS; ++i) {
+      if (m_filters[i].used && module == m_filters[i].module) {
+        m_filters[i].level = level;
+        return;
+      }
+      if (!m_filters[i].used && freeIdx < 0) freeIdx = i;
+    }
+    if (freeIdx < 0) {
+      Serial.println("[LogManager] No free module filter slot");
+      return;
+    }
+    strlcpy(m_filters[freeIdx].module, module.c_str(), sizeof(m_filters[freeIdx].module));
+    m_filters[freeIdx].level = level;
+    m_filters[freeIdx].used = true;
+  }
+
+  LogLevel getModuleLevel(const char* module) const {
+    for (int i = 0; i < MAX_FILTERS; ++i) {
+      if (m_filters[i].used && strcmp(m_filters[i].module, module) == 0) return m_filters[i].level;
+    }
+    return m_defaultLevel;
+  }
+
+  uint32_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+  void printStatus() const {
+    Serial.printf("[LogManager] Default level: %s, pending: %u/%u, dropped: %lu\n",
+                  levelToString(m_defaultLevel),
+                  (unsigned)(m_enqueuePos.load(std::memory_order_relaxed) - m_dequeuePos),
+                  (unsigned)RING_SIZE, getDropped());
+    for (int i = 0; i < MAX_FILTERS; ++i) {
+      if (m_filters[i].used) {
+        Serial.printf("[LogManager]   %s: %s\n", m_filters[i].module, levelToString(m_filters[i].level));
+      }
+    }
+  }
+
+  static const char* levelToString(LogLevel level) {
+    switch (level) {
+      case LogLevel::Debug: return "DEBUG";
+      case LogLevel::Info:  return "INFO";
+      case LogLevel::Warn:  return "WARN";
+      case LogLevel::Error: return "ERROR";
+      default:              return "NONE";
+    }
+  }
+
+  static bool levelFromString(const String& str, LogLevel& level) {
+    if (str.equalsIgnoreCase("debug")) level = LogLevel::Debug;
+    else if (str.equalsIgnoreCase("info")) level = LogLevel::Info;
+    else if (str.equalsIgnoreCase("warn")) level = LogLevel::Warn;
+    else if (str.equalsIgnoreCase("error")) level = LogLevel::Error;
+    else if (str.equalsIgnoreCase("none")) level = LogLevel::None;
+    else return false;
+    return true;
+  }
+
+private:
+  static constexpr size_t RING_SIZE = 32;            // must be a power of two
+  static constexpr size_t LINE_LEN = 192;
+  static constexpr size_t MODULE_LEN = 32;
+  static constexpr int MAX_FILTERS = 12;
+  static constexpr size_t BATCH_LINES = 8;           // ship early once this many are pending
+  static constexpr size_t BATCH_MAX_BYTES = 1400;    // keep one batch inside the MQTT buffer
+  static constexpr size_t BATCH_DOC_SIZE = 4096;
+  static constexpr size_t ENTRY_OVERHEAD_BYTES = 60; // {"ts":..,"values":{"log":"","level":""}}
+  static constexpr unsigned long FLUSH_INTERVAL_MS = 10000;
+
+  struct Slot {
+    std::atomic<size_t> seq;
+    LogLevel level;
+    uint64_t epochMs;
+    char text[LINE_LEN];
+  };
+
+  struct ModuleFilter {
+    bool used = false;
+    char module[MODULE_LEN];
+    LogLevel level;
+  };
+
+  Slot m_slots[RING_SIZE];
+  std::atomic<size_t> m_enqueuePos{0};
+  size_t m_dequeuePos = 0;                          // consumer (loop task) only
+  std::atomic<uint32_t> m_dropped{0};
+  uint32_t m_reportedDropped = 0;
+  unsigned long m_lastFlush = 0;
+
+  ModuleFilter m_filters[MAX_FILTERS];
+  LogLevel m_defaultLevel = LogLevel::Info;
+  BatchSink m_sink;
+
+  // "[Fans] current pwm ..." -> "Fans"; messages without a tag belong to ""
+  static void moduleOf(const String& message, char* out, size_t outLen) {
+    out[0] = '\0';
+    if (message.length() < 2 || message.charAt(0) != '[') return;
+    int end = message.indexOf(']');
+    if (end <= 1) return;
+    size_t len = min((size_t)(end - 1), outLen - 1);
+    memcpy(out, message.c_str() + 1, len);
+    out[len] = '\0';
+  }
+
+  // Wall clock in ms, 0 while the clock hasn't been set (ThingsBoard then uses server time)
+  static uint64_t epochMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000) return 0;
+    return (uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+  }
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * ModbusCapture
+ *
+ * Compact binary capture of the Modbus RTU traffic of one bus, written on the
+ * device by ModbusFrameRecorder and played back by ReplayTransport:
+ *
+ *   header   "MBCP" | version u8 | bus u8 | reserved u16 | baud u32      12 bytes
+ *   record   kind u8 | length u8 | time u32 | frame[length]              6 + length
+ *
+ *   REQUEST   time = ms since the capture started, frame = request as sent
+ *   RESPONSE  time = us from the end of the request to the end of the
+ *             exchange, frame = the bytes received (possibly partial or
+ *             corrupt); the high nibble of kind is the client's ModbusResult
+ *
+ * Little-endian, no padding: a 2-register read and its answer take 29 bytes.
+ * Depends on nothing but the C library, so host tools can read it as is.
+ */
+
+struct ModbusCaptureRecord {
+    static constexpr uint8_t REQUEST = 1;
+    static constexpr uint8_t RESPONSE = 2;
+
+    uint8_t kind = 0;
+    uint8_t result = 0;         // ModbusResult of a RESPONSE
+    uint32_t time = 0;
+    const uint8_t* frame = nullptr;
+    uint8_t length = 0;
+};
+
+// Receives every exchange of a ModbusRtuClient (see ModbusRtuClient::setFrameSink)
+class ModbusFrameSink {
+public:
+    virtual ~ModbusFrameSink() {}
+    virtual void onRequest(const uint8_t* frame, size_t length) = 0;
+    virtual void onResponse(const uint8_t* frame, size_t length, uint32_t elapsedUs, uint8_t result) = 0;
+};
+
+class ModbusCapture {
+public:
+    static constexpr uint32_t MAGIC = 0x5043424D;  // "MBCP"
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 12;
+    static constexpr size_t RECORD_HEADER_SIZE = 6;
+
+    static size_t encodeHeader(uint8_t* out, uint8_t bus, uint32_t baud) {
+        putU32(out, MAGIC);
+        out[4] = VERSION;
+        out[5] = bus;
+        out[6] = out[7] = 0;
+        putU32(out + 8, baud);
+        return HEADER_SIZE;
+    }
+
+    // out must hold RECORD_HEADER_SIZE + length bytes
+    static size_t encodeRecord(uint8_t* out, uint8_t kind, uint8_t result, uint32_t time,
+                               const uint8_t* frame, uint8_t length) {
+        out[0] = (uint8_t)(kind | (result << 4));
+        out[1] = length;
+        putU32(out + 2, time);
+        for (uint8_t i = 0; i < length; ++i) out[RECORD_HEADER_SIZE + i] = frame[i];
+        return RECORD_HEADER_SIZE + length;
+    }
+
+    // Walks a capture held in memory (the records point into the buffer)
+    class Reader {
+    public:
+        Reader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+        bool valid() const {
+            return _size >= HEADER_SIZE && getU32(_data) == MAGIC && _data[4] == VERSION;
+        }
+
+        uint8_t bus() const { return valid() ? _data[5] : 0; }
+        uint32_t baud() const { return valid() ? getU32(_data + 8) : 0; }
+
+        void rewind() { _pos = HEADER_SIZE; }
+
+        // next() without moving on
+        bool peek(ModbusCaptureRecord& record) {
+            size_t pos = _pos;
+            bool ok = next(record);
+            _pos = pos;
+            return ok;
+        }
+
+        // False at the end of the capture or at a truncated record
+        bool next(ModbusCaptureRecord& record) {
+            if (!valid() || _pos + RECORD_HEADER_SIZE > _size) return false;
+            const uint8_t* p = _data + _pos;
+            uint8_t length = p[1];
+            if (_pos + RECORD_HEADER_SIZE + length > _size) return false;
+            record.kind = p[0] & 0x0F;
+            record.result = p[0] >> 4;
+            record.length = length;
+            record.time = getU32(p + 2);
+            record.frame = p + RECORD_HEADER_SIZE;
+            _pos += RECORD_HEADER_SIZE + length;
+            return true;
+        }
+
+    private:
+        const uint8_t* _data;
+        size_t _size;
+        size_t _pos = HEADER_SIZE;
+    };
+
+private:
+    static void putU32(uint8_t* out, uint32_t v) {
+        for (int i = 0; i < 4; ++i) out[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    static uint32_t getU32(const uint8_t* in) {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <atomic>
+#include "ModbusCapture.h"
+#include "ModbusRtuClient.h"
+
+/**
+ * ModbusFrameRecorder
+ *
+ * Capture mode for field bus problems: records every request and response
+ * frame of one RS485 bus, with timestamps, into a ModbusCapture file on
+ * LittleFS. The bus task only copies the frames into a ring buffer; tick()
+ * writes them to flash from loop(), so recording doesn't change the bus
+ * timing it records. Records that don't fit in the ring are dropped whole
+ * (counted in getDropped()) and the file stays readable.
+ *
+ * The capture stops after its duration or MAX_FILE_BYTES. dump() prints the
+ * file as plain hex (xxd -r -p turns it back into the binary) for replay
+ * on a host with ReplayTransport.
+ */
+
+class ModbusFrameRecorder : public ModbusFrameSink {
+public:
+    static constexpr size_t MAX_FILE_BYTES = 256 * 1024;
+
+    explicit ModbusFrameRecorder(const char* path = "/rs485_capture.bin") : _path(path) {}
+
+    // Starts a new capture file; attach the recorder to the bus afterwards (setFrameSink)
+    bool start(uint8_t bus, uint32_t baud, unsigned long durationMs) {
+        stop();
+        if (!LittleFS.begin(true)) return false;
+        _file = LittleFS.open(_path, "w");
+        if (!_file) {
+            Serial.println("[Capture] Failed to open the capture file");
+            return false;
+        }
+        uint8_t header[ModbusCapture::HEADER_SIZE];
+        _file.write(header, ModbusCapture::encodeHeader(header, bus, baud));
+        _written = ModbusCapture::HEADER_SIZE;
+        _records.store(0, std::memory_order_relaxed);
+        _dropped.store(0, std::memory_order_relaxed);
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _startMs = millis();
+        _durationMs = durationMs;
+        _active.store(true, std::memory_order_release);
+        Serial.printf("[Capture] Recording bus %u at %lu baud for %lus to %s\n", bus, baud, durationMs / 1000, _path);
+        return true;
+    }
+
+    void stop() {
+        if (!_active.exchange(false)) return;
+        flush();
+        _file.close();
+        Serial.printf("[Capture] Stopped: %lu record(s), %u bytes, %lu dropped\n",
+                      _records.load(), (unsigned)_written, getDropped());
+    }
+
+    // Call from loop(): writes the buffered records and ends the capture when it's due
+    void tick() {
+        if (!_active.load(std::memory_order_acquire)) return;
+        flush();
+        if (millis() - _startMs >= _durationMs || _written >= MAX_FILE_BYTES) stop();
+    }
+
+    bool isActive() const { return _active.load(std::memory_order_acquire); }
+    uint32_t getDropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // ==== ModbusFrameSink (bus task) ====
+    // A request is only kept with room for its response, and a response only
+    // after its request, so replay never pairs frames of different exchanges
+    void onRequest(const uint8_t* frame, size_t length) override {
+        _requestKept = push(ModbusCaptureRecord::REQUEST, 0, millis() - _startMs, frame, length, RESPONSE_RESERVE);
+    }
+
+    void onResponse(const uint8_t* frame, size_t length, uint32_t elapsedUs, uint8_t result) override {
+        if (_requestKept) push(ModbusCaptureRecord::RESPONSE, result, elapsedUs, frame, length, 0);
+        _requestKept = false;
+    }
+
+    void printStatus() const {
+        Serial.printf("[Capture] %s, %u bytes in %s, %lu record(s), %lu dropped\n",
+                      isActive() ? "recording" : "idle", (unsigned)_written, _path, _records.load(), getDropped());
+    }
+
+    // The last capture as hex, 32 bytes per line
+    void dump() {
+        if (isActive() || !LittleFS.begin(true)) return;
+        File file = LittleFS.open(_path, "r");
+        if (!file) {
+            Serial.println("[Capture] No capture file");
+            return;
+        }
+        Serial.printf("[Capture] %s, %u bytes:\n", _path, (unsigned)file.size());
+        uint8_t buf[32];
+        size_t n;
+        while ((n = file.read(buf, sizeof(buf))) > 0) {
+            for (size_t i = 0; i < n; ++i) Serial.printf("%02x", buf[i]);
+            Serial.println();
+        }
+        file.close();
+        Serial.println("[Capture] end");
+    }
+
+private:
+    static constexpr size_t RING_SIZE = 4096;   // power of two
+    static constexpr size_t RESPONSE_RESERVE = ModbusCapture::RECORD_HEADER_SIZE + 5 + 2 * ModbusRtuClient::MAX_REGISTERS;
+
+    const char* _path;
+    File _file;
+    std::atomic<bool> _active{false};
+    unsigned long _startMs = 0;
+    unsigned long _durationMs = 0;
+    size_t _written = 0;
+
+    // Single producer (bus task), single consumer (loop)
+    uint8_t _ring[RING_SIZE];
+    std::atomic<size_t> _head{0};
+    std::atomic<size_t> _tail{0};
+    std::atomic<uint32_t> _dropped{0};
+    std::atomic<uint32_t> _records{0};
+    bool _requestKept = false;      // producer side only
+
+    bool push(uint8_t kind, uint8_t result, uint32_t time, const uint8_t* frame, size_t length, size_t reserve) {
+        if (!_active.load(std::memory_order_acquire)) return false;
+        if (length > 255) length = 255;
+        uint8_t record[ModbusCapture::RECORD_HEADER_SIZE + 255];
+        size_t size = ModbusCapture::encodeRecord(record, kind, result, time, frame, (uint8_t)length);
+
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        if (RING_SIZE - (head - tail) < size + reserve) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        for (size_t i = 0; i < size; ++i) _ring[(head + i) & (RING_SIZE - 1)] = record[i];
+        _head.store(head + size, std::memory_order_release);
+        _records.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void flush() {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t head = _head.load(std::memory_order_acquire);
+        while (tail != head) {
+            size_t offset = tail & (RING_SIZE - 1);
+            size_t chunk = min(head - tail, RING_SIZE - offset);
+            _file.write(_ring + offset, chunk);
+            _written += chunk;
+            tail += chunk;
+        }
+        _tail.store(tail, std::memory_order_release);
+    }
+};
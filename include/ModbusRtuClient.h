@@ -0,0 +1,215 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "ModbusTransport.h"
+#include "ModbusCapture.h"
+
+/**
+ * ModbusRtuClient
+ *
+ * Non-blocking Modbus RTU master for one RS485 bus (any ModbusTransport: the
+ * UART, or a capture being replayed). A request is started with
+ * start*() and completed by calling poll() from a tick; nothing here waits on
+ * the bus, so an offline sensor only costs its timeout in bus time, not in
+ * loop time.
+ *
+ * poll() waits for the frame to be fully shifted out (the transport turns
+ * the transceiver around at that moment, see UartTransport), then
+ * collects the response until its expected length (or an exception frame) is
+ * in, checking address, function code and CRC16.
+ *
+ * Time comes from the transport's ModbusClock, so the client builds and runs
+ * on a host against a ReplayTransport (see test/test_replay).
+ */
+
+enum class ModbusResult : uint8_t {
+    Pending,          // request in flight
+    Success,
+    Timeout,          // no (complete) response within the request timeout
+    CrcError,
+    Exception,        // slave answered with an exception code (see exceptionCode())
+    InvalidResponse,  // wrong address / function / length
+    Idle              // poll() without a request
+};
+
+class ModbusRtuClient {
+public:
+    static constexpr uint8_t FUNC_READ_INPUT_REGISTERS = 0x04;
+    static constexpr uint8_t FUNC_WRITE_SINGLE_REGISTER = 0x06;
+    static constexpr uint8_t MAX_REGISTERS = 16;
+
+    explicit ModbusRtuClient(ModbusTransport& transport) : _port(transport), _clock(transport.clock()) {}
+
+    void begin(uint32_t baud) {
+        _port.begin(baud);
+        _state = State::IDLE;
+    }
+
+    // Every request and response is also handed to the sink (capture); nullptr to stop.
+    // Only while no request is in flight.
+    void setFrameSink(ModbusFrameSink* sink) { _sink = sink; }
+
+    bool isIdle() const { return _state == State::IDLE; }
+
+    bool startReadInputRegisters(uint8_t addr, uint16_t reg, uint16_t count, unsigned long timeoutMs) {
+        if (count == 0 || count > MAX_REGISTERS) return false;
+        return start(addr, FUNC_READ_INPUT_REGISTERS, reg, count, 5 + 2 * count, timeoutMs);
+    }
+
+    bool startWriteSingleRegister(uint8_t addr, uint16_t reg, uint16_t value, unsigned long timeoutMs) {
+        return start(addr, FUNC_WRITE_SINGLE_REGISTER, reg, value, 8, timeoutMs); // echo of the request
+    }
+
+    // Drive the current request. Returns Pending until it completes; the final
+    // result is returned once, after that the client is idle again.
+    ModbusResult poll() {
+        switch (_state) {
+            case State::IDLE:
+                return ModbusResult::Idle;
+
+            case State::SENDING:
+                if (!_port.sendDone()) {
+                    if (_clock.nowMs() - _startMs > _timeoutMs) return finish(ModbusResult::Timeout);
+                    return ModbusResult::Pending;
+                }
+                _port.listen(); // last stop bit is out
+                _sentUs = _clock.nowUs();
+                _state = State::RECEIVING;
+                return ModbusResult::Pending;
+
+            case State::RECEIVING:
+                while (_port.available() && _rxLen < sizeof(_rx)) {
+                    _rx[_rxLen++] = _port.read();
+                    // Exception frame: addr, func | 0x80, code, crc
+                    if (_rxLen == 2 && (_rx[1] & 0x80)) _expectedLen = 5;
+                }
+                if (_rxLen >= _expectedLen) {
+                    _latencyUs = _clock.nowUs() - _sentUs;
+                    return finish(parseResponse());
+                }
+                if (_clock.nowMs() - _startMs > _timeoutMs) return finish(ModbusResult::Timeout);
+                return ModbusResult::Pending;
+        }
+        return ModbusResult::Idle;
+    }
+
+    // Start a request and poll it to completion (setup / commissioning only)
+    ModbusResult readInputRegistersBlocking(uint8_t addr, uint16_t reg, uint16_t count, unsigned long timeoutMs) {
+        if (!startReadInputRegisters(addr, reg, count, timeoutMs)) return ModbusResult::InvalidResponse;
+        return waitForResult();
+    }
+
+    ModbusResult writeSingleRegisterBlocking(uint8_t addr, uint16_t reg, uint16_t value, unsigned long timeoutMs) {
+        if (!startWriteSingleRegister(addr, reg, value, timeoutMs)) return ModbusResult::InvalidResponse;
+        return waitForResult();
+    }
+
+    uint16_t getRegister(uint8_t i) const { return i < MAX_REGISTERS ? _registers[i] : 0; }
+    uint8_t exceptionCode() const { return _exceptionCode; }
+    uint32_t lastLatencyUs() const { return _latencyUs; }  // end of request frame to end of response
+
+    static const char* resultToString(ModbusResult result) {
+        switch (result) {
+            case ModbusResult::Pending:         return "pending";
+            case ModbusResult::Success:         return "ok";
+            case ModbusResult::Timeout:         return "timeout";
+            case ModbusResult::CrcError:        return "crc";
+            case ModbusResult::Exception:       return "exception";
+            case ModbusResult::InvalidResponse: return "invalid";
+            default:                            return "idle";
+        }
+    }
+
+    static uint16_t crc16(const uint8_t* data, size_t length) {
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < length; ++i) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; ++b) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        return crc;
+    }
+
+private:
+    enum class State : uint8_t { IDLE, SENDING, RECEIVING };
+
+    ModbusTransport& _port;
+    ModbusClock& _clock;
+    ModbusFrameSink* _sink = nullptr;
+
+    State _state = State::IDLE;
+    uint8_t _addr = 0;
+    uint8_t _func = 0;
+    uint16_t _count = 0;
+    unsigned long _startMs = 0;
+    unsigned long _timeoutMs = 0;
+    unsigned long _sentUs = 0;
+    uint32_t _latencyUs = 0;
+
+    uint8_t _rx[5 + 2 * MAX_REGISTERS];
+    size_t _rxLen = 0;
+    size_t _expectedLen = 0;
+    uint16_t _registers[MAX_REGISTERS] = {0};
+    uint8_t _exceptionCode = 0;
+
+    bool start(uint8_t addr, uint8_t func, uint16_t reg, uint16_t value, size_t expectedLen, unsigned long timeoutMs) {
+        if (_state != State::IDLE) return false;
+
+        uint8_t frame[8] = {
+            addr, func,
+            (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF),
+            (uint8_t)(value >> 8), (uint8_t)(value & 0xFF)
+        };
+        uint16_t crc = crc16(frame, 6);
+        frame[6] = crc & 0xFF;  // CRC goes low byte first
+        frame[7] = crc >> 8;
+
+        while (_port.available()) _port.read(); // drop late bytes of an earlier response
+
+        _addr = addr;
+        _func = func;
+        _count = (func == FUNC_READ_INPUT_REGISTERS) ? value : 0;
+        _rxLen = 0;
+        _expectedLen = expectedLen;
+        _exceptionCode = 0;
+        _timeoutMs = timeoutMs;
+        _startMs = _clock.nowMs();
+
+        _sentUs = _clock.nowUs();
+        _port.send(frame, sizeof(frame));
+        if (_sink) _sink->onRequest(frame, sizeof(frame));
+        _state = State::SENDING;
+        return true;
+    }
+
+    ModbusResult finish(ModbusResult result) {
+        _port.listen();
+        if (_sink) _sink->onResponse(_rx, _rxLen, _clock.nowUs() - _sentUs, (uint8_t)result);
+        _state = State::IDLE;
+        return result;
+    }
+
+    ModbusResult waitForResult() {
+        ModbusResult result;
+        while ((result = poll()) == ModbusResult::Pending) _clock.sleepMs(1);
+        return result;
+    }
+
+    ModbusResult parseResponse() {
+        uint16_t crc = crc16(_rx, _expectedLen - 2);
+        if (_rx[_expectedLen - 2] != (crc & 0xFF) || _rx[_expectedLen - 1] != (crc >> 8)) return ModbusResult::CrcError;
+        if (_rx[0] != _addr) return ModbusResult::InvalidResponse;
+        if (_rx[1] == (_func | 0x80)) {
+            _exceptionCode = _rx[2];
+            return ModbusResult::Exception;
+        }
+        if (_rx[1] != _func) return ModbusResult::InvalidResponse;
+
+        if (_func == FUNC_READ_INPUT_REGISTERS) {
+            if (_rx[2] != 2 * _count) return ModbusResult::InvalidResponse;
+            for (uint16_t i = 0; i < _count; ++i) {
+                _registers[i] = ((uint16_t)_rx[3 + 2 * i] << 8) | _rx[4 + 2 * i];
+            }
+        }
+        return ModbusResult::Success;
+    }
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * ModbusTransport
+ *
+ * The half-duplex byte link under ModbusRtuClient. UartTransport
+ * (UartTransport.h) drives an RS485 transceiver on an ESP32 UART;
+ * ReplayTransport (ReplayTransport.h) plays back a capture instead, so the
+ * client and SHTManager_RS485 run unchanged against recorded bus traffic.
+ *
+ * Bus timing (request timeouts, reply delays) is read from the transport's
+ * ModbusClock, not from millis() / micros(): on the device that's the Arduino
+ * clock, on a host the harness steps time, so a replay is deterministic.
+ * Nothing here depends on the Arduino core.
+ */
+
+class ModbusClock {
+public:
+    virtual ~ModbusClock() {}
+
+    virtual uint32_t nowMs() = 0;
+    virtual uint32_t nowUs() = 0;
+
+    // Blocking wait (setup / commissioning only)
+    virtual void sleepMs(uint32_t ms) = 0;
+};
+
+class ModbusTransport {
+public:
+    virtual ~ModbusTransport() {}
+
+    // (Re)open the link at a baud rate
+    virtual void begin(uint32_t baud) = 0;
+
+    // Take the bus and start sending a request frame
+    virtual void send(const uint8_t* frame, size_t length) = 0;
+
+    // True once the last stop bit of the frame is out
+    virtual bool sendDone() = 0;
+
+    // Release the bus and listen for the response
+    virtual void listen() = 0;
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+
+    // Time base of the link
+    virtual ModbusClock& clock() = 0;
+};
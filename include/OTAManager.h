@@ -7,9 +7,26 @@
 #include <Update.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <map>
 #include "mbedtls/sha256.h"
 #include "mbedtls/md.h"  // For SHA256 checksum
 #include "esp_ota_ops.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include <atomic>
+#include "PublishScheduler.h"
+#include "TelemetryProto.h"
+#include "AttributeCache.h"
+#include "OtaMetrics.h"
+
+// Control outage of an update, carried across the reboot into the new firmware.
+// RTC_NOINIT memory survives a software reset; the magic tells a real record from garbage.
+struct OtaOutageRecord {
+  uint32_t magic;
+  uint32_t shutdownMs;  // from the safe shutdown to ESP.restart()
+};
+static RTC_NOINIT_ATTR OtaOutageRecord s_otaOutage;
+static constexpr uint32_t OTA_OUTAGE_MAGIC = 0x4F55545A;
 
 class OTAManager {
 public:
@@ -37,17 +54,17 @@ public:
   std::function<void(bool)> setDrippersAutoModeFunc;
   std::function<void(int)> setInnerFansSpeedFunc;
   std::function<int()> getInnerFansSpeedFunc;
+  std::function<void(JsonObjectConst)> applySystemConfigFunc;
 
   OTAManager(PubSubClient &mqttClient, const String& fwVersion, const String& deviceToken)
-    : m_mqttClient(mqttClient), m_fwVersion(fwVersion), m_token(deviceToken) {
+    : m_mqttClient(mqttClient), m_fwVersion(fwVersion), m_token(deviceToken), m_publisher(mqttClient) {
       m_mqttClient.setServer(THINGSBOARD_SERVER.c_str(), 1883);
+      m_mqttClient.setBufferSize(MQTT_BUFFER_SIZE); // room for batched logs / telemetry
+      m_publisher.setPublishedCallback([this](const String& key) { this->onTelemetryPublished(key); });
     }
 
   void begin() {
-    Serial.println("[OTA] Initializing LittleFS...");
-    if (!LittleFS.begin(true)) {
-      Serial.println("[OTA] Failed to mount LittleFS");
-    }
+    mountFS();
 
     m_mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
       this->handleMqttMessage(topic, payload, length);
@@ -56,11 +73,51 @@ public:
     checkAndConfirmOTA();
   }
 
+  // Apply the last shared attributes received from ThingsBoard, without waiting
+  // for the network. Call once at boot after the apply callbacks are set.
+  void applyCachedAttributes() {
+    mountFS();
+    if (!m_attrCache.load()) return;
+    applySharedAttributes(m_attrCache.values());
+    Serial.printf("[Config] Applied cached attributes (generation %lu)\n", m_attrCache.generation());
+  }
+
+  void printAttributeCache() const {
+    m_attrCache.printStatus();
+  }
+
   void tick() {
     if (!m_mqttClient.connected()) {
       connectMQTT();
     }
     m_mqttClient.loop();
+    pollFirmwareJob();
+    if (m_pendingOutageMs && m_mqttClient.connected()) {
+      sendTelemetry("fw_control_outage_ms", (float)m_pendingOutageMs, PublishPriority::State);
+      m_pendingOutageMs = 0;
+    }
+    m_publisher.tick();
+  }
+
+  // Call once control is running again after boot. If the previous firmware
+  // rebooted into this one for an update, the total outage gets reported.
+  void reportControlOutage(unsigned long controlResumedMs) {
+    if (s_otaOutage.magic != OTA_OUTAGE_MAGIC) return;
+    s_otaOutage.magic = 0;
+    // Doesn't include the bootloader time between restart and millis() = 0
+    m_pendingOutageMs = s_otaOutage.shutdownMs + controlResumedMs;
+    Serial.printf("[OTA] Control outage during update: %lu ms (%lu ms before reboot, %lu ms after)\n",
+                  m_pendingOutageMs, (unsigned long)s_otaOutage.shutdownMs, controlResumedMs);
+  }
+
+  // Transfer metrics of the last updates, kept in flash
+  void printOtaMetrics() const {
+    m_otaMetricsStore.printAll();
+  }
+
+  bool isFirmwareUpdateInProgress() const {
+    FirmwareJobState state = m_fwJobState.load();
+    return state == FirmwareJobState::Downloading || state == FirmwareJobState::Verified;
   }
 
   void connectMQTT() {
@@ -75,6 +132,8 @@ public:
         Serial.print("[MQTT] Connecting...");
         if (m_mqttClient.connect("", m_token.c_str(), "")) {
           Serial.println(" connected!");
+          m_attributeCache.clear(); // static attributes go out again once per connection
+          m_telemetryCache.clear(); // and every delta value, the broker may have missed the last ones
           subscribeTopics();
         } else {
           Serial.printf(" failed, rc=%d\n", m_mqttClient.state());
@@ -91,10 +150,10 @@ public:
     if (esp_ota_get_state_partition(NULL, &ota_state) == ESP_OK) {
       if (ota_state == ESP_OTA_IMG_PENDING_VERIFY) {
         Serial.println("[OTA] Firmware is pending verify - will be validated by health check system");
-        sendTelemetry("fw_state", "PENDING_VALIDATION");
+        sendFwState("PENDING_VALIDATION");
       } else {
         Serial.println("[OTA] Firmware is already valid.");
-        sendTelemetry("fw_state", "VALID");
+        sendFwState("VALID");
       }
     } else {
       Serial.println("[OTA] Failed to get OTA state!");
@@ -107,7 +166,9 @@ public:
     m_mqttClient.subscribe("v1/devices/me/attributes");            // for push
     m_mqttClient.subscribe("v1/devices/me/rpc/request/+");         // for RPC
 
-    m_mqttClient.publish("v1/devices/me/attributes/request/1", "{\"sharedKeys\":\"systemConfig,fw_version,fw_checksum,fw_size,fw_title\"}");
+    m_publisher.enqueue(PublishPriority::State, "v1/devices/me/attributes/request/1",
+                        "{\"sharedKeys\":\"systemConfig,fw_version,fw_checksum,fw_size,fw_title,telemetry_encoding,telemetry_keepalive_min\"}",
+                        "attributes_request");
   }
 
   void handleRPC(const String& topic, JsonDocument& doc) {
@@ -121,7 +182,7 @@ public:
       int fanSpeed = getFanSpeedFunc();
       String response = String(fanSpeed);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent fan speed: %d\n", fanSpeed);
 
     } else if (method == "setFanSpeed") { // ========== setFansSpeed
@@ -133,7 +194,7 @@ public:
       bool state = getDampersStatusFunc();
       String response = state ? "true" : "false";
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent dampers status: %d\n", state);
 
     } else if (method == "setDampersStatus") {  // ======= setDampersStatus
@@ -145,7 +206,7 @@ public:
       bool state = getSolenoidStatusFunc();
       String response = state ? "true" : "false";
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent solenoid status: %d\n", state);
 
     } else if (method == "setSolenoidStatus") {  // ======= setSolenoidStatus
@@ -157,7 +218,7 @@ public:
       int slot = getWaterSlotFunc();
       String response = String(slot);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent water slot: %d\n", slot);
 
     } else if (method == "setWaterSlot") {  // ======= setSlot
@@ -169,7 +230,7 @@ public:
       int budget = getWaterBudgetFunc();
       String response = String(budget);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent water budget: %d\n", budget);
 
     } else if (method == "setWaterBudget") {  // ======= setBudget
@@ -181,7 +242,7 @@ public:
       int slot = getSprinklersSlotFunc();
       String response = String(slot);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent sprinklers slot: %d\n", slot);
 
     } else if (method == "setSprinklersSlot") {  // ======= setSprinklersSlot
@@ -193,7 +254,7 @@ public:
       int budget = getSprinklersBudgetFunc();
       String response = String(budget);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent sprinklers budget: %d\n", budget);
 
     } else if (method == "setSprinklersBudget") {  // ======= setSprinklersBudget
@@ -205,7 +266,7 @@ public:
       bool mode = getSystemAutoModeFunc();
       String response = mode ? "true" : "false";
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent system auto mode status: %d\n", mode);
 
     } else if (method == "setSystemAutoMode") {  // ======= setSystemAutoMode
@@ -217,14 +278,14 @@ public:
       bool mode = getDrippersAutoModeFunc();
       String response = mode ? "true" : "false";
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent drippers auto mode status: %d\n", mode);
 
     } else if (method == "getSprinklersMode") {  // ====== getSprinklersMode
       bool mode = getSprinklersModeFunc();
       String response = mode ? "true" : "false";
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Sent sprinklers mode: %d\n", mode);
 
     } else if (method == "setSprinklersMode") {  // ======= setSprinklersMode
@@ -247,7 +308,7 @@ public:
 
       String response = String(speed);
       String responseTopic = "v1/devices/me/rpc/response/" + requestId;
-      m_mqttClient.publish(responseTopic.c_str(), response.c_str());
+      m_publisher.enqueue(PublishPriority::State, responseTopic, response);
       Serial.printf("[RPC] Get inner fan speed: %d\n", speed);
 
     } else if (method == "restartDevice") {  // ======= restartDevice
@@ -287,6 +348,9 @@ public:
       return;
     }
 
+    // === Cached attributes (systemConfig, telemetry settings) ===
+    reconcileSharedAttributes(shared);
+
     if (shared["fw_version"].is<String>()) {
       String fwVersion = shared["fw_version"] | "";
 
@@ -296,38 +360,20 @@ public:
         String fwURL = shared["fw_url"] | "";
         size_t fwSize = shared["fw_size"] | 0;
 
-        triggerBeforeFirmwareUpdate(); // Call the callback before firmware update
-
-        Serial.printf("[OTA] New firmware %s version %s. Downloading...\n", fwTitle.c_str(), fwVersion.c_str());
-        downloadFirmware(fwURL, fwSize, fwChecksum, fwTitle, fwVersion);
+        if (isFirmwareUpdateInProgress()) {
+          Serial.printf("[OTA] Update already in progress, ignoring version %s\n", fwVersion.c_str());
+        } else {
+          // Control keeps running during the download; the safe shutdown
+          // happens in finishFirmwareUpdate(), right before Update.end()
+          Serial.printf("[OTA] New firmware %s version %s. Downloading...\n", fwTitle.c_str(), fwVersion.c_str());
+          downloadFirmware(fwURL, fwSize, fwChecksum, fwTitle, fwVersion);
+        }
       } else {
         Serial.printf("[OTA] Firmware version %s is already installed\n", fwVersion);
       }
     } else {
       Serial.println("[OTA] bad fw_version in shared");
     }
-
-    // === SystemConfig handling ===
-    if (doc["systemConfig"].is<JsonVariant>()) {
-      String configJson;
-      serializeJson(doc["systemConfig"], configJson);
-      Serial.printf("[Config] Received systemConfig: %s\n", configJson.c_str());
-      saveConfig(configJson);
-    }
-  }
-
-  void saveConfig(const String& configJson) {
-    Serial.println("[OTA] Saving config to /config.json...");
-    File f = LittleFS.open("/config.json", "w");
-    if (!f) {
-      Serial.println("[OTA] Failed to open config file for writing");
-      return;
-    }
-    f.print(configJson);
-    f.close();
-    Serial.println("[OTA] Config saved. Rebooting...");
-    delay(1000);
-    ESP.restart();
   }
 
   void downloadFirmware(const String& pushedUrl, size_t fwSize, const String& fwChecksum,
@@ -352,48 +398,401 @@ public:
     Serial.printf("[OTA] Expected size: %d bytes\n", fwSize);
     Serial.printf("[OTA] Expected SHA256 checksum: %s\n", fwChecksum.c_str());
 
+    m_fwJob.url = url;
+    m_fwJob.size = fwSize;
+    m_fwJob.checksum = fwChecksum;
+    m_fwJob.metrics = OtaTransferMetrics();
+    strlcpy(m_fwJob.metrics.version, fwVersion.c_str(), sizeof(m_fwJob.metrics.version));
+    m_fwJob.metrics.sizeBytes = fwSize;
+    m_fwJob.error[0] = '\0';
+    m_fwJob.written = 0;
+    m_fwJobState = FirmwareJobState::Downloading;
+    m_reportedJobState = FirmwareJobState::Idle;
+
+    // TLS + HTTP + flash writes run in their own task; loop() keeps controlling
+    if (xTaskCreatePinnedToCore(firmwareTask, "ota_download", FW_TASK_STACK, this, 1, nullptr, 0) != pdPASS) {
+      Serial.println("[OTA] Failed to start download task");
+      m_fwJobState = FirmwareJobState::Idle;
+      sendFwState("FAILED");
+    }
+  }
+
+  // For floats, ints, or other numeric
+  void sendTelemetry(const String& key, float value, PublishPriority priority = PublishPriority::Telemetry) {
+    if (WiFi.status() != WL_CONNECTED) {
+      Serial.println("[OTA-Telemetry] WiFi not connected. Skipping telemetry.");
+      return;
+    }
+    if (!m_mqttClient.connected()) {
+      Serial.println("[OTA-Telemetry] MQTT not connected. Skipping telemetry.");
+      return;
+    }
+
+    if (m_encoding == TelemetryEncoding::Protobuf) {
+      const TelemetryProto::KeyInfo* info = TelemetryProto::findKey(key.c_str());
+      uint8_t buf[PROTO_BUFFER_SIZE];
+      size_t len = info ? TelemetryProto::encodeFloat(buf, sizeof(buf), *info, value) : 0;
+      if (len > 0) {
+        enqueueTelemetry(priority, key, buf, len);
+        return;
+      }
+    }
+
+    StaticJsonDocument<256> doc;
+    doc[key] = value;
+    String payload;
+    serializeJson(doc, payload);
+
+    Serial.printf("[OTA-Telemetry] Publishing: %s\n", payload.c_str());
+    enqueueTelemetry(priority, key, reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length());
+  }
+
+  // Overload for String values (e.g., fw_state, fw_version)
+  void sendTelemetry(const String& key, const String& value, PublishPriority priority = PublishPriority::Telemetry) {
+    if (WiFi.status() != WL_CONNECTED) {
+      Serial.println("[OTA-Telemetry] WiFi not connected. Skipping telemetry.");
+      return;
+    }
+    if (!m_mqttClient.connected()) {
+      Serial.println("[OTA-Telemetry] MQTT not connected. Skipping telemetry.");
+      return;
+    }
+
+    if (m_encoding == TelemetryEncoding::Protobuf) {
+      const TelemetryProto::KeyInfo* info = TelemetryProto::findKey(key.c_str());
+      uint8_t buf[PROTO_BUFFER_SIZE];
+      size_t len = info ? TelemetryProto::encodeString(buf, sizeof(buf), *info, value.c_str(), value.length()) : 0;
+      if (len > 0) {
+        enqueueTelemetry(priority, key, buf, len);
+        return;
+      }
+    }
+
+    StaticJsonDocument<256> doc;
+    doc[key] = value;
+    String payload;
+    serializeJson(doc, payload);
+
+    //Serial.printf("[OTA-Telemetry] Publishing: %s\n", payload.c_str());
+    enqueueTelemetry(priority, key, reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length());
+  }
+
+  // Batched log lines (see LogManager) - lowest priority, first to be dropped under load
+  void sendLogBatch(const JsonDocument& batch) {
+    if (WiFi.status() != WL_CONNECTED || !m_mqttClient.connected()) return;
+
+    String payload;
+    serializeJson(batch, payload);
+    m_publisher.enqueue(PublishPriority::Log, "v1/devices/me/telemetry", payload);
+  }
+
+  void sendTelemetryBatch(const JsonDocument& doc, PublishPriority priority = PublishPriority::Telemetry) {
+    if (WiFi.status() != WL_CONNECTED) return;
+    if (!m_mqttClient.connected()) return;
+
+    String payload;
+    serializeJson(doc, payload);
+    //Serial.printf("[OTA-Telemetry] Batch: %s\n", payload.c_str());
+    m_publisher.enqueue(priority, "v1/devices/me/telemetry", payload);
+  }
+
+  void sendAttribute(const String& key, const String& value) {
+    if (WiFi.status() != WL_CONNECTED) {
+      Serial.println("[OTA-Attr] WiFi not connected. Skipping attribute.");
+      return;
+    }
+    if (!m_mqttClient.connected()) {
+      Serial.println("[OTA-Attr] MQTT not connected. Skipping attribute.");
+      return;
+    }
+
+    StaticJsonDocument<256> doc;
+    doc[key] = value;
+    String payload;
+    serializeJson(doc, payload);
+
+    //Serial.printf("[OTA-Attr] Publishing attribute: %s\n", payload.c_str());
+    m_publisher.enqueue(PublishPriority::State, "v1/devices/me/attributes", payload, key);
+  }
+
+  // Wrapper for float
+  void sendAttribute(const String& key, float value) {
+    sendAttribute(key, String(value, 2)); // 2 decimal places
+  }
+
+  // Wrapper for int
+  void sendAttribute(const String& key, int value) {
+    sendAttribute(key, String(value));
+  }
+
+  // === Delta telemetry ===
+  // Periodic values are published only when they differ from the last sent value,
+  // or when the keep-alive interval for that key has expired.
+  void sendTelemetryIfChanged(const String& key, float value, PublishPriority priority = PublishPriority::Telemetry) {
+    if (shouldSendTelemetry(key, String(value, 2))) sendTelemetry(key, value, priority);
+  }
+
+  void sendTelemetryIfChanged(const String& key, const String& value, PublishPriority priority = PublishPriority::Telemetry) {
+    if (shouldSendTelemetry(key, value)) sendTelemetry(key, value, priority);
+  }
+
+  // Static facts: sent as attributes once per MQTT connection, and again if the value changes
+  void sendAttributeOnce(const String& key, const String& value) {
+    if (WiFi.status() != WL_CONNECTED || !m_mqttClient.connected()) return;
+
+    auto it = m_attributeCache.find(key);
+    if (it != m_attributeCache.end() && it->second == value) return;
+    m_attributeCache[key] = value;
+    sendAttribute(key, value);
+  }
+
+  void sendAttributeOnce(const String& key, int value) {
+    sendAttributeOnce(key, String(value));
+  }
+
+  void setTelemetryKeepAliveMs(unsigned long keepAliveMs) {
+    m_telemetryKeepAliveMs = keepAliveMs;
+    Serial.printf("[OTA-Telemetry] Keep-alive set to %lu s\n", keepAliveMs / 1000);
+  }
+
+  unsigned long getTelemetryKeepAliveMs() const {
+    return m_telemetryKeepAliveMs;
+  }
+
+  void printTelemetryCache() {
+    unsigned long now = millis();
+    Serial.printf("[OTA-Telemetry] Keep-alive %lu s, suppressed %lu, %u cached keys\n",
+                  m_telemetryKeepAliveMs / 1000, m_suppressedCount, (unsigned)m_telemetryCache.size());
+    for (const auto& entry : m_telemetryCache) {
+      Serial.printf("  %s = %s (sent %lu s ago)\n", entry.first.c_str(), entry.second.value.c_str(),
+                    (now - entry.second.sentMs) / 1000);
+    }
+  }
+
+  void setBeforeFirmwareUpdateCallback(std::function<void()> callback) {
+    onBeforeFirmwareUpdate = callback;
+  }
+
+  // Protobuf needs the device profile's telemetry schema (see TelemetryProto::schema())
+  void setTelemetryEncoding(TelemetryEncoding encoding) {
+    if (encoding == m_encoding) return;
+    m_encoding = encoding;
+    Serial.printf("[OTA-Telemetry] Encoding set to %s\n", encoding == TelemetryEncoding::Protobuf ? "protobuf" : "json");
+  }
+
+  TelemetryEncoding getTelemetryEncoding() const {
+    return m_encoding;
+  }
+
+  // Compare bytes and CPU per message of the JSON and protobuf paths on a typical telemetry set
+  void benchmarkEncoding(int iterations = 200) {
+    struct Sample { const char* key; float number; const char* text; };
+    static const Sample samples[] = {
+      { "RS485_Ambiant_Temp", 31.4f, nullptr }, { "RS485_Ambiant_RH", 42.7f, nullptr },
+      { "RS485_Before_Temp", 29.8f, nullptr },  { "RS485_Before_RH", 88.1f, nullptr },
+      { "RS485_After_Temp", 24.2f, nullptr },   { "RS485_After_RH", 93.5f, nullptr },
+      { "RS485_Room_Temp", 25.9f, nullptr },    { "RS485_Room_RH", 55.0f, nullptr },
+      { "Fans_Speed", 35.0f, nullptr },         { "InnerFan_PWM", 29.8f, nullptr },
+      { "System_Mode", 0, "Regenerate" },       { "Dampers_Actual", 0, "Open" },
+      { "Regeneration_Status", 0, "Active" },   { "OTA_Status", 0, "NORMAL" }
+    };
+    const int sampleCount = sizeof(samples) / sizeof(samples[0]);
+
+    // Every output goes into the sink, so the compiler can't drop iterations
+    size_t jsonBytes = 0, protoBytes = 0;
+    volatile uint32_t sink = 0;
+    unsigned long start = micros();
+    for (int it = 0; it < iterations; ++it) {
+      for (int i = 0; i < sampleCount; ++i) {
+        StaticJsonDocument<256> doc;
+        if (samples[i].text) doc[samples[i].key] = samples[i].text;
+        else doc[samples[i].key] = samples[i].number;
+        String payload;
+        serializeJson(doc, payload);
+        if (it == 0) jsonBytes += payload.length();
+        sink = sink + payload.length() + (uint8_t)payload[payload.length() / 2];
+      }
+    }
+    unsigned long jsonUs = micros() - start;
+
+    start = micros();
+    for (int it = 0; it < iterations; ++it) {
+      for (int i = 0; i < sampleCount; ++i) {
+        uint8_t buf[PROTO_BUFFER_SIZE];
+        const TelemetryProto::KeyInfo* info = TelemetryProto::findKey(samples[i].key);
+        size_t len = !info ? 0
+                   : samples[i].text ? TelemetryProto::encodeString(buf, sizeof(buf), *info, samples[i].text, strlen(samples[i].text))
+                   : TelemetryProto::encodeFloat(buf, sizeof(buf), *info, samples[i].number);
+        if (it == 0) protoBytes += len;
+        uint32_t sum = len;
+        for (size_t b = 0; b < len; ++b) sum += buf[b];
+        sink = sink + sum;
+      }
+    }
+    unsigned long protoUs = micros() - start;
+
+    const float messages = (float)iterations * sampleCount;
+    Serial.printf("[OTA-Telemetry] Encoding benchmark: %d messages x %d iterations\n", sampleCount, iterations);
+    Serial.printf("[OTA-Telemetry]   json:     %.1f bytes/msg, %.2f us/msg\n", (float)jsonBytes / sampleCount, jsonUs / messages);
+    Serial.printf("[OTA-Telemetry]   protobuf: %.1f bytes/msg, %.2f us/msg\n", (float)protoBytes / sampleCount, protoUs / messages);
+    Serial.printf("[OTA-Telemetry]   (checksum %lu)\n", (unsigned long)sink);
+  }
+
+  // Push out everything still queued (call before a restart)
+  void flushPublishQueue() {
+    m_publisher.flush();
+  }
+
+  void printPublishStats() {
+    m_publisher.printStats();
+  }
+
+  // Per-class queue latency and drop counters, max latency is reset per report
+  void sendPublishStats() {
+    static const char* names[PublishScheduler::CLASS_COUNT] = { "state", "telemetry", "log" };
+    StaticJsonDocument<512> doc;
+    for (int i = 0; i < PublishScheduler::CLASS_COUNT; ++i) {
+      const PublishScheduler::ClassStats& stats = m_publisher.getStats(static_cast<PublishPriority>(i));
+      doc[String("MQTT_") + names[i] + "_latency_avg_ms"] = stats.avgLatencyMs();
+      doc[String("MQTT_") + names[i] + "_latency_max_ms"] = stats.latencyMaxMs;
+      doc[String("MQTT_") + names[i] + "_dropped"] = stats.dropped;
+    }
+    m_publisher.resetLatencyMax();
+    sendTelemetryBatch(doc);
+  }
+
+private:
+  PubSubClient &m_mqttClient;
+  String m_fwVersion;
+  String m_token;
+
+  PublishScheduler m_publisher;
+  static constexpr uint16_t MQTT_BUFFER_SIZE = 2048;
+  static constexpr size_t PROTO_BUFFER_SIZE = 128;
+
+#ifdef TELEMETRY_PROTOBUF
+  TelemetryEncoding m_encoding = TelemetryEncoding::Protobuf;
+#else
+  TelemetryEncoding m_encoding = TelemetryEncoding::Json;
+#endif
+
+  unsigned long lastMqttAttempt = 0;
+  const unsigned long mqttReconnectInterval = 5000;
+
+  void enqueueTelemetry(PublishPriority priority, const String& key, const uint8_t* payload, size_t length) {
+    // Periodic values may collapse into the newest queued one; state changes are kept in order
+    String mergeKey = (priority == PublishPriority::Telemetry) ? key : "";
+    m_publisher.enqueue(priority, "v1/devices/me/telemetry", payload, length, mergeKey, key);
+  }
+
+  void sendFwState(const String& state) {
+    sendTelemetry("fw_state", state, PublishPriority::State);
+  }
+
+  // === Background firmware download ===
+  enum class FirmwareJobState : uint8_t {
+    Idle,
+    Downloading,  // download task running
+    Verified,     // image written and checksum OK, waiting for finishFirmwareUpdate()
+    Failed        // download task ended with m_fwJob.error
+  };
+
+  struct FirmwareJob {
+    String url;
+    size_t size = 0;
+    String checksum;
+    volatile size_t written = 0;
+    char error[64];
+    OtaTransferMetrics metrics;  // filled by the task, read by the loop after the state changes
+  };
+
+  static constexpr uint32_t FW_TASK_STACK = 12288;           // TLS handshake needs the room
+  static constexpr unsigned long FW_STALL_TIMEOUT_MS = 30000; // no data for this long aborts
+
+  FirmwareJob m_fwJob;
+  OtaMetricsStore m_otaMetricsStore;
+  std::atomic<FirmwareJobState> m_fwJobState{FirmwareJobState::Idle};
+  FirmwareJobState m_reportedJobState = FirmwareJobState::Idle;
+  unsigned long m_pendingOutageMs = 0;
+
+  static void firmwareTask(void* arg) {
+    OTAManager* self = static_cast<OTAManager*>(arg);
+    self->m_fwJobState = self->runFirmwareDownload() ? FirmwareJobState::Verified : FirmwareJobState::Failed;
+    vTaskDelete(nullptr);
+  }
+
+  // Download task body. Must not touch MQTT - results go through m_fwJobState.
+  bool runFirmwareDownload() {
+    FirmwareJob& job = m_fwJob;
+    OtaTransferMetrics& metrics = job.metrics;
+    time_t wallClock = time(nullptr);
+    if (wallClock > 1600000000) metrics.epoch = (uint32_t)wallClock;
+
+    // Split the URL so DNS and connect+TLS can be timed on their own
+    int hostStart = job.url.indexOf("://");
+    hostStart = (hostStart < 0) ? 0 : hostStart + 3;
+    int hostEnd = job.url.indexOf('/', hostStart);
+    if (hostEnd < 0) hostEnd = job.url.length();
+    String host = job.url.substring(hostStart, hostEnd);
+    uint16_t port = job.url.startsWith("http://") ? 80 : 443;
+    int colon = host.indexOf(':');
+    if (colon >= 0) {
+      port = host.substring(colon + 1).toInt();
+      host = host.substring(0, colon);
+    }
+
+    unsigned long phaseStart = millis();
+    IPAddress ip;
+    if (!WiFi.hostByName(host.c_str(), ip)) {
+      return failJob("DNS lookup failed");
+    }
+    metrics.dnsMs = millis() - phaseStart;
+
     // Use WiFiClientSecure for HTTPS
     WiFiClientSecure client;
     client.setCACert(thingsboard_root_ca_cert);
     //WiFiClient client;
     HTTPClient http;
 
+    // Connect up front (hostname, so TLS verifies it; the DNS answer is cached now).
+    // HTTPClient reuses an already connected client.
+    phaseStart = millis();
+    if (!client.connect(host.c_str(), port)) {
+      return failJob("Connect/TLS failed");
+    }
+    metrics.connectMs = millis() - phaseStart;
+
     Serial.printf("[OTA] Starting download...\n");
-    if (!http.begin(client, url)) {
-      Serial.println("[OTA] HTTPClient begin() failed!");
-      sendTelemetry("fw_state", "FAILED");
-      return;
+    http.setReuse(true);
+    if (!http.begin(client, job.url)) {
+      return failJob("HTTPClient begin() failed");
     }
 
+    phaseStart = millis();
     int httpCode = http.GET();
+    metrics.ttfbMs = millis() - phaseStart;
     if (httpCode != HTTP_CODE_OK) {
       Serial.printf("[OTA] HTTP GET failed, code: %d\n", httpCode);
-      sendTelemetry("fw_state", "FAILED");
       http.end();
-      return;
+      return failJob("HTTP GET failed");
     }
 
     int contentLength = http.getSize();
     if (contentLength <= 0) {
-      Serial.println("[OTA] Invalid content length!");
-      sendTelemetry("fw_state", "FAILED");
       http.end();
-      return;
+      return failJob("Invalid content length");
     }
 
-    if (contentLength != (int)fwSize) {
-      Serial.printf("[OTA] Content length mismatch! Expected: %d, Got: %d\n", fwSize, contentLength);
-      sendTelemetry("fw_state", "FAILED");
+    if (contentLength != (int)job.size) {
+      Serial.printf("[OTA] Content length mismatch! Expected: %d, Got: %d\n", job.size, contentLength);
       http.end();
-      return;
+      return failJob("Content length mismatch");
     }
 
     WiFiClient *stream = http.getStreamPtr();
     if (!Update.begin(contentLength)) {
-      Serial.println("[OTA] Not enough space to begin OTA");
-      sendTelemetry("fw_state", "FAILED");
       http.end();
-      return;
+      return failJob("Not enough space to begin OTA");
     }
 
     // === SHA256 ===
@@ -404,52 +803,93 @@ public:
     size_t written = 0;
     uint8_t buff[512];
     unsigned long lastProgress = millis();
+    unsigned long lastData = millis();
 
-    sendTelemetry("fw_state", "DOWNLOADING");
+    // Transfer metrics
+    unsigned long transferStart = 0;
+    unsigned long windowStart = 0;
+    uint32_t windowBytes = 0;
+    unsigned long idleSince = 0;
+    uint64_t flashUs = 0;
+    uint64_t hashUs = 0;
 
-    esp_task_wdt_delete(NULL); // removes current task from the watchdog
-    while (http.connected() && written < contentLength) {
+    while (http.connected() && written < (size_t)contentLength) {
       size_t available = stream->available();
-      if (available) {
-        int readLen = stream->readBytes(buff, min(available, sizeof(buff)));
-        if (readLen <= 0) continue;
-
-        // Update SHA256
-        mbedtls_sha256_update_ret(&shaCtx, buff, readLen);
-
-        // Write chunk to flash
-        if (Update.write(buff, readLen) != readLen) {
-          Serial.println("[OTA] Write failed!");
-          Update.abort();
-          sendTelemetry("fw_state", "FAILED");
-          http.end();
-          return;
-        }
+      if (!available) {
+        if (!idleSince) idleSince = millis();
+        if (millis() - lastData > FW_STALL_TIMEOUT_MS) break;
+        vTaskDelay(pdMS_TO_TICKS(5)); // let the idle task and the control loop run
+        continue;
+      }
 
-        written += readLen;
+      int readLen = stream->readBytes(buff, min(available, sizeof(buff)));
+      if (readLen <= 0) continue;
 
-        if (millis() - lastProgress > 1000) {
-          int percent = (written * 100) / contentLength;
-          Serial.printf("[OTA] Progress: %d%% (%d/%d bytes)\n", percent, written, contentLength);
-          lastProgress = millis();
-        }
+      unsigned long now = millis();
+      lastData = now;
+      if (!transferStart) transferStart = windowStart = now;
+      if (idleSince && now - idleSince >= OtaTransferMetrics::STALL_MIN_MS) {
+        metrics.stallCount++;
+        metrics.stallMs += now - idleSince;
+      }
+      idleSince = 0;
+
+      windowBytes += readLen;
+      if (now - windowStart >= OtaTransferMetrics::WINDOW_MS) {
+        uint32_t bps = (uint32_t)((uint64_t)windowBytes * 1000 / (now - windowStart));
+        if (metrics.minWindowBps == 0 || bps < metrics.minWindowBps) metrics.minWindowBps = bps;
+        windowStart = now;
+        windowBytes = 0;
+      }
+
+      // Update SHA256
+      int64_t t0 = esp_timer_get_time();
+      mbedtls_sha256_update_ret(&shaCtx, buff, readLen);
+      int64_t t1 = esp_timer_get_time();
+
+      // Write chunk to flash
+      size_t flashed = Update.write(buff, readLen);
+      hashUs += t1 - t0;
+      flashUs += esp_timer_get_time() - t1;
+      if (flashed != (size_t)readLen) {
+        mbedtls_sha256_free(&shaCtx);
+        Update.abort();
+        http.end();
+        return failJob("Write failed");
+      }
+
+      written += readLen;
+      job.written = written;
+      metrics.bytesReceived = written;
+
+      if (millis() - lastProgress > 1000) {
+        int percent = (written * 100) / contentLength;
+        Serial.printf("[OTA] Progress: %d%% (%d/%d bytes)\n", percent, written, contentLength);
+        lastProgress = millis();
       }
     }
-    esp_task_wdt_add(NULL); // adds the current thread (loopTask) back to the watchdog
+    http.end();
 
-    if (written != contentLength) {
+    metrics.flashWriteMs = flashUs / 1000;
+    if (transferStart) {
+      metrics.transferMs = lastData - transferStart;
+      if (metrics.transferMs) metrics.avgBps = (uint32_t)((uint64_t)written * 1000 / metrics.transferMs);
+    }
+
+    if (written != (size_t)contentLength) {
       Serial.printf("[OTA] Mismatch! Written: %d bytes, Expected: %d bytes\n", written, contentLength);
+      mbedtls_sha256_free(&shaCtx);
       Update.abort();
-      sendTelemetry("fw_state", "FAILED");
-      http.end();
-      return;
+      return failJob("Download incomplete");
     }
-    sendTelemetry("fw_state", "DOWNLOADED");  // download finished
 
     // === close SHA256 ===
     uint8_t result[32];
+    int64_t t0 = esp_timer_get_time();
     mbedtls_sha256_finish_ret(&shaCtx, result);
     mbedtls_sha256_free(&shaCtx);
+    hashUs += esp_timer_get_time() - t0;
+    metrics.hashMs = hashUs / 1000;
 
     // Convert binary hash to hex string
     char hexResult[65] = {0};
@@ -459,125 +899,195 @@ public:
 
     Serial.printf("[OTA] Calculated SHA256: %s\n", hexResult);
 
-    if (fwChecksum != String(hexResult)) {
-      Serial.println("[OTA] Checksum mismatch! Aborting OTA.");
+    if (job.checksum != String(hexResult)) {
       Update.abort();
-      sendTelemetry("fw_state", "FAILED");
-      http.end();
-      return;
+      return failJob("Checksum mismatch");
     }
-    sendTelemetry("fw_state", "VERIFIED");  // checksum verified
+    metrics.success = 1;
+    return true;
+  }
+
+  bool failJob(const char* reason) {
+    Serial.printf("[OTA] %s! Aborting OTA.\n", reason);
+    strlcpy(m_fwJob.error, reason, sizeof(m_fwJob.error));
+    return false;
+  }
+
+  // Loop side of the download: publish progress states and finish the update
+  void pollFirmwareJob() {
+    FirmwareJobState state = m_fwJobState.load();
+    if (state == m_reportedJobState) return;
+    m_reportedJobState = state;
+
+    switch (state) {
+      case FirmwareJobState::Downloading:
+        sendFwState("DOWNLOADING");
+        break;
+      case FirmwareJobState::Verified:
+        sendFwState("DOWNLOADED");  // download finished
+        sendFwState("VERIFIED");    // checksum verified
+        recordOtaMetrics();
+        finishFirmwareUpdate();
+        break;
+      case FirmwareJobState::Failed:
+        recordOtaMetrics();
+        sendTelemetry("fw_error", String(m_fwJob.error), PublishPriority::State);
+        sendFwState("FAILED");
+        m_fwJobState = FirmwareJobState::Idle;
+        m_reportedJobState = FirmwareJobState::Idle;
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Loop side: store the finished job's metrics and publish them as one record
+  void recordOtaMetrics() {
+    const OtaTransferMetrics& metrics = m_fwJob.metrics;
+    metrics.print();
+    m_otaMetricsStore.append(metrics);
+
+    StaticJsonDocument<768> doc;
+    metrics.toJson(doc.to<JsonObject>());
+    sendTelemetryBatch(doc, PublishPriority::State);
+  }
+
+  // The only part of an update that stops control: safe shutdown, Update.end(), reboot
+  void finishFirmwareUpdate() {
+    unsigned long shutdownStart = millis();
+    triggerBeforeFirmwareUpdate();
 
     if (Update.end()) {
       Serial.println("[OTA] OTA update finished!");
       if (Update.isFinished()) {
         Serial.println("[OTA] OTA successful. Rebooting...");
-        sendTelemetry("fw_state", "UPDATING");
+        sendFwState("UPDATING");
+        flushPublishQueue();
+        s_otaOutage.shutdownMs = millis() - shutdownStart;
+        s_otaOutage.magic = OTA_OUTAGE_MAGIC;
         ESP.restart();
       } else {
         Serial.println("[OTA] OTA not finished properly.");
-        sendTelemetry("fw_state", "FAILED");
+        sendFwState("FAILED");
       }
     } else {
       Serial.print("[OTA] OTA update failed: ");
       Update.printError(Serial);
-      sendTelemetry("fw_state", "FAILED");
+      sendFwState("FAILED");
     }
 
-    http.end();
+    // No reboot - control resumes on the next loop
+    m_pendingOutageMs = millis() - shutdownStart;
+    m_fwJobState = FirmwareJobState::Idle;
+    m_reportedJobState = FirmwareJobState::Idle;
   }
 
-  // For floats, ints, or other numeric
-  void sendTelemetry(const String& key, float value) {
-    if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("[OTA-Telemetry] WiFi not connected. Skipping telemetry.");
-      return;
-    }
-    if (!m_mqttClient.connected()) {
-      Serial.println("[OTA-Telemetry] MQTT not connected. Skipping telemetry.");
-      return;
-    }
+  // === Shared attribute cache ===
+  AttributeCache m_attrCache;
+  bool m_fsMounted = false;
 
-    StaticJsonDocument<256> doc;
-    doc[key] = value;
-    String payload;
-    serializeJson(doc, payload);
-
-    Serial.printf("[OTA-Telemetry] Publishing: %s\n", payload.c_str());
-    m_mqttClient.publish("v1/devices/me/telemetry", payload.c_str());
+  void mountFS() {
+    if (m_fsMounted) return;
+    Serial.println("[OTA] Initializing LittleFS...");
+    m_fsMounted = LittleFS.begin(true);
+    if (!m_fsMounted) {
+      Serial.println("[OTA] Failed to mount LittleFS");
+    }
   }
 
-  // Overload for String values (e.g., fw_state, fw_version)
-  void sendTelemetry(const String& key, const String& value) {
-    if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("[OTA-Telemetry] WiFi not connected. Skipping telemetry.");
-      return;
-    }
-    if (!m_mqttClient.connected()) {
-      Serial.println("[OTA-Telemetry] MQTT not connected. Skipping telemetry.");
-      return;
+  // Apply shared attributes, whether they came from the broker or the cache
+  void applySharedAttributes(JsonObjectConst shared) {
+    // === Delta telemetry keep-alive (minutes) ===
+    if (shared["telemetry_keepalive_min"].is<int>()) {
+      int minutes = shared["telemetry_keepalive_min"] | 0;
+      if (minutes > 0) setTelemetryKeepAliveMs((unsigned long)minutes * 60UL * 1000UL);
     }
 
-    StaticJsonDocument<256> doc;
-    doc[key] = value;
-    String payload;
-    serializeJson(doc, payload);
+    // === Telemetry encoding ("json" / "protobuf") ===
+    if (shared["telemetry_encoding"].is<const char*>()) {
+      String encoding = shared["telemetry_encoding"] | "";
+      setTelemetryEncoding(encoding.equalsIgnoreCase("protobuf") ? TelemetryEncoding::Protobuf : TelemetryEncoding::Json);
+    }
 
-    //Serial.printf("[OTA-Telemetry] Publishing: %s\n", payload.c_str());
-    m_mqttClient.publish("v1/devices/me/telemetry", payload.c_str());
+    // === SystemConfig ===
+    if (shared["systemConfig"].is<JsonObjectConst>()) {
+      String configJson;
+      serializeJson(shared["systemConfig"], configJson);
+      Serial.printf("[Config] Applying systemConfig: %s\n", configJson.c_str());
+      if (applySystemConfigFunc) applySystemConfigFunc(shared["systemConfig"].as<JsonObjectConst>());
+    }
   }
 
-  void sendTelemetryBatch(const JsonDocument& doc) {
-    if (WiFi.status() != WL_CONNECTED) return;
-    if (!m_mqttClient.connected()) return;
+  // Compare broker attributes with the cache; apply and persist only what changed
+  void reconcileSharedAttributes(JsonObjectConst shared) {
+    static const char* const CACHED_KEYS[] = { "systemConfig", "telemetry_encoding", "telemetry_keepalive_min" };
 
-    String payload;
-    serializeJson(doc, payload);
-    //Serial.printf("[OTA-Telemetry] Batch: %s\n", payload.c_str());
-    m_mqttClient.publish("v1/devices/me/telemetry", payload.c_str());
-  }
-
-  void sendAttribute(const String& key, const String& value) {
-    if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("[OTA-Attr] WiFi not connected. Skipping attribute.");
-      return;
+    DynamicJsonDocument changed(1024);
+    JsonObject changedObj = changed.to<JsonObject>();
+    for (const char* key : CACHED_KEYS) {
+      JsonVariantConst value = shared[key];
+      if (value.isNull()) continue;
+      if (m_attrCache.update(key, value)) changedObj[key] = value;
     }
-    if (!m_mqttClient.connected()) {
-      Serial.println("[OTA-Attr] MQTT not connected. Skipping attribute.");
+
+    if (changedObj.size() == 0) {
+      Serial.println("[Config] Shared attributes match the cache");
       return;
     }
 
-    StaticJsonDocument<256> doc;
-    doc[key] = value;
-    String payload;
-    serializeJson(doc, payload);
-
-    //Serial.printf("[OTA-Attr] Publishing attribute: %s\n", payload.c_str());
-    m_mqttClient.publish("v1/devices/me/attributes", payload.c_str());
+    Serial.printf("[Config] %u shared attribute(s) changed\n", (unsigned)changedObj.size());
+    applySharedAttributes(changed.as<JsonObjectConst>());
+    m_attrCache.save();
+    if (!changedObj["systemConfig"].isNull()) saveConfig(changedObj["systemConfig"]);
   }
 
-  // Wrapper for float
-  void sendAttribute(const String& key, float value) {
-    sendAttribute(key, String(value, 2)); // 2 decimal places
+  // Keep /config.json as before (the raw systemConfig as received), now without
+  // the reboot - the config is applied live through applySystemConfigFunc
+  void saveConfig(JsonVariantConst config) {
+    File f = LittleFS.open("/config.json", "w");
+    if (!f) {
+      Serial.println("[OTA] Failed to open config file for writing");
+      return;
+    }
+    serializeJson(config, f);
+    f.close();
+    Serial.println("[OTA] Config saved to /config.json");
   }
 
-  // Wrapper for int
-  void sendAttribute(const String& key, int value) {
-    sendAttribute(key, String(value));
+  // === Delta telemetry cache ===
+  // A value only counts as sent once the publisher confirms it went out; until
+  // then it waits in m_telemetryPending and an unchanged value is enqueued again
+  struct TelemetryCacheEntry {
+    String value;
+    unsigned long sentMs;
+  };
+  std::map<String, TelemetryCacheEntry> m_telemetryCache;
+  std::map<String, String> m_telemetryPending;
+  std::map<String, String> m_attributeCache;
+  unsigned long m_telemetryKeepAliveMs = 30UL * 60UL * 1000UL;
+  unsigned long m_suppressedCount = 0;
+
+  bool shouldSendTelemetry(const String& key, const String& value) {
+    if (WiFi.status() != WL_CONNECTED || !m_mqttClient.connected()) return false;
+
+    unsigned long now = millis();
+    auto it = m_telemetryCache.find(key);
+    if (it != m_telemetryCache.end() && it->second.value == value &&
+        now - it->second.sentMs < m_telemetryKeepAliveMs) {
+      m_suppressedCount++;
+      return false;
+    }
+    m_telemetryPending[key] = value;
+    return true;
   }
 
-  void setBeforeFirmwareUpdateCallback(std::function<void()> callback) {
-    onBeforeFirmwareUpdate = callback;
+  void onTelemetryPublished(const String& key) {
+    auto it = m_telemetryPending.find(key);
+    if (it == m_telemetryPending.end()) return;
+    m_telemetryCache[key] = { it->second, millis() };
+    m_telemetryPending.erase(it);
   }
 
-private:
-  PubSubClient &m_mqttClient;
-  String m_fwVersion;
-  String m_token;
-
-  unsigned long lastMqttAttempt = 0;
-  const unsigned long mqttReconnectInterval = 5000;
-
   std::function<void()> onBeforeFirmwareUpdate = nullptr;
   void triggerBeforeFirmwareUpdate() {
     if (onBeforeFirmwareUpdate) {
@@ -0,0 +1,124 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+
+/**
+ * OtaMetrics
+ *
+ * Per-update transfer metrics recorded by the firmware download task, and a
+ * small flash store that keeps the last MAX_RECORDS of them (/ota_metrics.bin)
+ * so they survive the reboot into the new firmware.
+ *
+ * Throughput is measured in WINDOW_MS windows; the minimum only counts full
+ * windows. A stall is a gap of at least STALL_MIN_MS with available() == 0.
+ */
+
+struct OtaTransferMetrics {
+  static constexpr unsigned long WINDOW_MS = 1000;
+  static constexpr unsigned long STALL_MIN_MS = 200;
+
+  uint32_t epoch = 0;          // wall clock at start (0 if not set)
+  char version[16] = "";
+  uint32_t sizeBytes = 0;
+  uint32_t bytesReceived = 0;
+  uint32_t dnsMs = 0;          // hostname lookup
+  uint32_t connectMs = 0;      // TCP connect + TLS handshake
+  uint32_t ttfbMs = 0;         // GET sent to response headers received
+  uint32_t transferMs = 0;     // first body byte to last
+  uint32_t avgBps = 0;
+  uint32_t minWindowBps = 0;
+  uint16_t stallCount = 0;
+  uint32_t stallMs = 0;
+  uint32_t flashWriteMs = 0;   // time inside Update.write()
+  uint32_t hashMs = 0;         // time inside SHA256 update/finish
+  uint8_t success = 0;
+
+  void toJson(JsonObject obj) const {
+    obj["ota_version"] = version;
+    obj["ota_success"] = success;
+    obj["ota_size"] = sizeBytes;
+    obj["ota_received"] = bytesReceived;
+    obj["ota_dns_ms"] = dnsMs;
+    obj["ota_connect_ms"] = connectMs;
+    obj["ota_ttfb_ms"] = ttfbMs;
+    obj["ota_transfer_ms"] = transferMs;
+    obj["ota_avg_bps"] = avgBps;
+    obj["ota_min_window_bps"] = minWindowBps;
+    obj["ota_stall_count"] = stallCount;
+    obj["ota_stall_ms"] = stallMs;
+    obj["ota_flash_write_ms"] = flashWriteMs;
+    obj["ota_hash_ms"] = hashMs;
+  }
+
+  void print() const {
+    Serial.printf("[OTA-Metrics] %s %s: %lu/%lu B, dns %lums, connect+tls %lums, ttfb %lums, transfer %lums\n",
+                  version, success ? "OK" : "FAILED", bytesReceived, sizeBytes, dnsMs, connectMs, ttfbMs, transferMs);
+    Serial.printf("[OTA-Metrics]   avg %lu B/s, min window %lu B/s, stalls %u (%lums), flash %lums, hash %lums\n",
+                  avgBps, minWindowBps, stallCount, stallMs, flashWriteMs, hashMs);
+  }
+};
+
+class OtaMetricsStore {
+public:
+  static constexpr uint8_t MAX_RECORDS = 8;
+
+  explicit OtaMetricsStore(const char* path = "/ota_metrics.bin") : m_path(path) {}
+
+  // Append a record, dropping the oldest one when full
+  bool append(const OtaTransferMetrics& metrics) {
+    FileData data;
+    load(data);
+
+    if (data.count < MAX_RECORDS) {
+      data.records[data.count++] = metrics;
+    } else {
+      memmove(&data.records[0], &data.records[1], sizeof(OtaTransferMetrics) * (MAX_RECORDS - 1));
+      data.records[MAX_RECORDS - 1] = metrics;
+    }
+
+    File f = LittleFS.open(m_path, "w");
+    if (!f) {
+      Serial.println("[OTA-Metrics] Failed to open metrics file for writing");
+      return false;
+    }
+    data.magic = MAGIC;
+    data.recordSize = sizeof(OtaTransferMetrics);
+    bool ok = f.write(reinterpret_cast<const uint8_t*>(&data), sizeof(data)) == sizeof(data);
+    f.close();
+    return ok;
+  }
+
+  void printAll() const {
+    FileData data;
+    load(data);
+    Serial.printf("[OTA-Metrics] %u stored update(s)\n", data.count);
+    for (uint8_t i = 0; i < data.count; ++i) data.records[i].print();
+  }
+
+private:
+  static constexpr uint32_t MAGIC = 0x4D41544F;  // "OTAM"
+
+  struct FileData {
+    uint32_t magic = 0;
+    uint16_t recordSize = 0;
+    uint8_t count = 0;
+    OtaTransferMetrics records[MAX_RECORDS];
+  };
+
+  const char* m_path;
+
+  // Missing file or a different record layout (older firmware) starts empty
+  void load(FileData& data) const {
+    File f = LittleFS.open(m_path, "r");
+    if (f) {
+      size_t n = f.read(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+      f.close();
+      if (n == sizeof(data) && data.magic == MAGIC && data.recordSize == sizeof(OtaTransferMetrics) &&
+          data.count <= MAX_RECORDS) {
+        return;
+      }
+    }
+    data.count = 0;
+  }
+};
@@ -0,0 +1,237 @@
+#pragma once
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * PublishScheduler
+ *
+ * Outbound MQTT queue shared by everything that publishes to ThingsBoard.
+ * Messages are split into priority classes (State > Telemetry > Log); a
+ * higher class is always drained before a lower one, and a token bucket
+ * caps the uplink byte rate so a burst of logs can't starve state updates.
+ *
+ * Queue policies:
+ *  - Entries enqueued with a merge key replace an older queued entry of the
+ *    same class and key (latest value wins).
+ *  - When the Telemetry or Log class is full, its oldest entry is dropped.
+ *  - State is never dropped from the queue: when it's full a new entry is
+ *    rejected (enqueue() returns false, counted as failed), so what's already
+ *    queued - RPC responses, fw_state, outage reports - still goes out.
+ *
+ * Entries may carry a tag; the published callback gets it once the entry
+ * actually went out (not when it's merged away, dropped or rejected).
+ *
+ * Call tick() every loop to drain the queues.
+ */
+
+enum class PublishPriority : uint8_t {
+  State = 0,      // alarms, mode changes, fw_state, RPC responses
+  Telemetry = 1,  // periodic sensor / status values
+  Log = 2         // free-text log lines
+};
+
+class PublishScheduler {
+public:
+  static constexpr int CLASS_COUNT = 3;
+
+  struct ClassStats {
+    uint32_t enqueued = 0;
+    uint32_t published = 0;
+    uint32_t merged = 0;
+    uint32_t dropped = 0;
+    uint32_t failed = 0;
+    uint32_t latencySumMs = 0;
+    uint32_t latencyMaxMs = 0;
+
+    uint32_t avgLatencyMs() const { return published ? latencySumMs / published : 0; }
+  };
+
+  /**
+   * @param bytesPerSecond Sustained uplink budget (token refill rate).
+   * @param burstBytes Bucket size - how many bytes may go out back to back.
+   */
+  PublishScheduler(PubSubClient& client, uint32_t bytesPerSecond = 2048, uint32_t burstBytes = 4096)
+    : m_client(client),
+      m_bytesPerSecond(bytesPerSecond),
+      m_burstBytes(burstBytes),
+      m_tokens(burstBytes),
+      m_lastRefill(millis()) {}
+
+  bool enqueue(PublishPriority prio, const String& topic, const uint8_t* payload, size_t length,
+               const String& mergeKey = "", const String& tag = "") {
+    int cls = static_cast<int>(prio);
+    std::deque<Entry>& queue = m_queues[cls];
+    ClassStats& stats = m_stats[cls];
+    stats.enqueued++;
+
+    if (mergeKey.length() > 0) {
+      for (Entry& e : queue) {
+        if (e.mergeKey == mergeKey && e.topic == topic) {
+          e.payload.assign(payload, payload + length);
+          e.tag = tag;
+          stats.merged++;
+          return true;
+        }
+      }
+    }
+
+    if (queue.size() >= capacityOf(cls)) {
+      if (prio == PublishPriority::State) {
+        stats.failed++;
+        Serial.printf("[MQTT-Queue] State queue full, rejected %s\n", topic.c_str());
+        return false;
+      }
+      queue.pop_front();
+      stats.dropped++;
+    }
+
+    Entry e;
+    e.topic = topic;
+    e.payload.assign(payload, payload + length);
+    e.mergeKey = mergeKey;
+    e.tag = tag;
+    e.enqueuedMs = millis();
+    queue.push_back(std::move(e));
+    return true;
+  }
+
+  bool enqueue(PublishPriority prio, const String& topic, const String& payload, const String& mergeKey = "") {
+    return enqueue(prio, topic, reinterpret_cast<const uint8_t*>(payload.c_str()), payload.length(), mergeKey);
+  }
+
+  void setPublishedCallback(std::function<void(const String& tag)> callback) {
+    m_onPublished = callback;
+  }
+
+  // Drain as much as the token bucket allows, highest class first.
+  void tick() {
+    refill();
+    if (!m_client.connected()) return;
+
+    for (int sent = 0; sent < MAX_PUBLISH_PER_TICK; ++sent) {
+      int cls = nextClass();
+      if (cls < 0) return;
+
+      Entry& e = m_queues[cls].front();
+      uint32_t cost = costOf(e);
+      // A message larger than the whole bucket may go once the bucket is full
+      if (cost > m_tokens && m_tokens < m_burstBytes) return;
+
+      if (!publish(cls)) return;
+      m_tokens = (cost >= m_tokens) ? 0 : m_tokens - cost;
+    }
+  }
+
+  // Publish everything queued, ignoring the rate limit (used before a reboot).
+  void flush(unsigned long timeoutMs = 2000) {
+    unsigned long start = millis();
+    while (m_client.connected() && millis() - start < timeoutMs) {
+      int cls = nextClass();
+      if (cls < 0) break;
+      if (!publish(cls) && !m_client.connected()) break;
+      m_client.loop();
+    }
+  }
+
+  size_t queued(PublishPriority prio) const { return m_queues[static_cast<int>(prio)].size(); }
+  const ClassStats& getStats(PublishPriority prio) const { return m_stats[static_cast<int>(prio)]; }
+
+  // Start a fresh latency window (counters keep accumulating)
+  void resetLatencyMax() {
+    for (int i = 0; i < CLASS_COUNT; ++i) m_stats[i].latencyMaxMs = 0;
+  }
+
+  void setRateLimit(uint32_t bytesPerSecond, uint32_t burstBytes) {
+    m_bytesPerSecond = bytesPerSecond;
+    m_burstBytes = burstBytes;
+    if (m_tokens > m_burstBytes) m_tokens = m_burstBytes;
+  }
+
+  void printStats() const {
+    static const char* names[CLASS_COUNT] = { "State", "Telemetry", "Log" };
+    Serial.printf("[MQTT-Queue] Rate limit: %lu B/s, burst %lu B, tokens %lu\n",
+                  m_bytesPerSecond, m_burstBytes, m_tokens);
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+      const ClassStats& s = m_stats[i];
+      Serial.printf("[MQTT-Queue] %-9s queued=%u sent=%lu merged=%lu dropped=%lu failed=%lu latency avg=%lums max=%lums\n",
+                    names[i], (unsigned)m_queues[i].size(), s.published, s.merged, s.dropped, s.failed,
+                    s.avgLatencyMs(), s.latencyMaxMs);
+    }
+  }
+
+private:
+  struct Entry {
+    String topic;
+    std::vector<uint8_t> payload;
+    String mergeKey;
+    String tag;
+    unsigned long enqueuedMs;
+  };
+
+  static constexpr int MAX_PUBLISH_PER_TICK = 8;
+  static constexpr uint32_t MQTT_OVERHEAD_BYTES = 5; // fixed header + topic length
+
+  PubSubClient& m_client;
+  std::function<void(const String& tag)> m_onPublished = nullptr;
+  std::deque<Entry> m_queues[CLASS_COUNT];
+  ClassStats m_stats[CLASS_COUNT];
+
+  uint32_t m_bytesPerSecond;
+  uint32_t m_burstBytes;
+  uint32_t m_tokens;
+  unsigned long m_lastRefill;
+
+  void refill() {
+    unsigned long now = millis();
+    unsigned long elapsed = now - m_lastRefill;
+    uint32_t add = (uint32_t)((uint64_t)elapsed * m_bytesPerSecond / 1000);
+    if (add == 0) return;
+    m_lastRefill = now;
+    m_tokens = min(m_burstBytes, m_tokens + add);
+  }
+
+  static size_t capacityOf(int cls) {
+    switch (cls) {
+      case 0:  return 32;  // State
+      case 1:  return 48;  // Telemetry
+      default: return 24;  // Log
+    }
+  }
+
+  int nextClass() const {
+    for (int i = 0; i < CLASS_COUNT; ++i) {
+      if (!m_queues[i].empty()) return i;
+    }
+    return -1;
+  }
+
+  static uint32_t costOf(const Entry& e) {
+    return e.topic.length() + e.payload.size() + MQTT_OVERHEAD_BYTES;
+  }
+
+  bool publish(int cls) {
+    Entry& e = m_queues[cls].front();
+    ClassStats& stats = m_stats[cls];
+
+    if (!m_client.publish(e.topic.c_str(), e.payload.data(), e.payload.size())) {
+      stats.failed++;
+      // Still connected means the frame itself was rejected (e.g. larger than
+      // the client buffer) - drop it so it doesn't block the queue forever
+      if (m_client.connected()) m_queues[cls].pop_front();
+      return false;
+    }
+
+    uint32_t latency = millis() - e.enqueuedMs;
+    stats.published++;
+    stats.latencySumMs += latency;
+    if (latency > stats.latencyMaxMs) stats.latencyMaxMs = latency;
+
+    String tag = e.tag;
+    m_queues[cls].pop_front();
+    if (m_onPublished && tag.length() > 0) m_onPublished(tag);
+    return true;
+  }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/**
+ * RS485AddressMap
+ *
+ * Bus baud rate, inter-frame gap and the Modbus address of each sensor role
+ * on one RS485 bus (0 = the role is on another bus), as found by discovery and
+ * bus tuning (/rs485_map.bin). Later boots apply it and verify every role with
+ * a single read instead of scanning the bus again.
+ *
+ * A file with a wrong magic, role count or checksum is ignored, so the
+ * factory addresses from setup() are used instead.
+ *
+ * Next to it, bus tuning keeps a migration marker (/rs485_tune.bin) while the
+ * sensors switch baud rate: found at boot, it means the switch was cut short
+ * (reset, power loss) and the sensors may not be at the map's rate.
+ */
+
+struct RS485AddressMap {
+    static constexpr uint8_t MAX_ROLES = 8;
+
+    uint32_t baud = 0;
+    uint16_t gapMs = 0;              // idle time before each request (0 = default)
+    uint8_t roleCount = 0;
+    uint8_t addr[MAX_ROLES] = {0};   // indexed by SHTManager_RS485::SensorIndex, 0 = not on this bus
+};
+
+class RS485AddressMapStore {
+public:
+    // One file per bus: /rs485_map.bin for the first, /rs485_map<bus>.bin for the others
+    explicit RS485AddressMapStore(uint8_t bus = 0) {
+        if (bus == 0) {
+            snprintf(_path, sizeof(_path), "/rs485_map.bin");
+            snprintf(_migrationPath, sizeof(_migrationPath), "/rs485_tune.bin");
+        } else {
+            snprintf(_path, sizeof(_path), "/rs485_map%u.bin", bus);
+            snprintf(_migrationPath, sizeof(_migrationPath), "/rs485_tune%u.bin", bus);
+        }
+    }
+
+    bool load(RS485AddressMap& map) {
+        if (!mount()) return false;
+        File f = LittleFS.open(_path, "r");
+        if (!f) return false;
+
+        FileData data;
+        size_t n = f.read(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+        f.close();
+        if (n != sizeof(data) || data.magic != MAGIC || data.map.roleCount > RS485AddressMap::MAX_ROLES ||
+            data.checksum != checksum(data.map)) {
+            Serial.println("[RS485] Address map is corrupted, ignoring it");
+            return false;
+        }
+        map = data.map;
+        return true;
+    }
+
+    bool save(const RS485AddressMap& map) {
+        if (!mount()) return false;
+        File f = LittleFS.open(_path, "w");
+        if (!f) {
+            Serial.println("[RS485] Failed to open address map for writing");
+            return false;
+        }
+        FileData data;
+        data.magic = MAGIC;
+        data.map = map;
+        data.checksum = checksum(map);
+        bool ok = f.write(reinterpret_cast<const uint8_t*>(&data), sizeof(data)) == sizeof(data);
+        f.close();
+        return ok;
+    }
+
+    bool remove() { return mount() && LittleFS.remove(_path); }
+
+    // ==== Baud migration marker ====
+    bool saveMigration(uint32_t fromBaud, uint32_t toBaud) {
+        if (!mount()) return false;
+        File f = LittleFS.open(_migrationPath, "w");
+        if (!f) {
+            Serial.println("[RS485] Failed to open migration marker for writing");
+            return false;
+        }
+        uint32_t data[4] = { MIGRATION_MAGIC, fromBaud, toBaud, MIGRATION_MAGIC ^ fromBaud ^ (toBaud << 1) };
+        bool ok = f.write(reinterpret_cast<const uint8_t*>(data), sizeof(data)) == sizeof(data);
+        f.close();
+        return ok;
+    }
+
+    bool loadMigration(uint32_t& fromBaud, uint32_t& toBaud) {
+        if (!mount()) return false;
+        File f = LittleFS.open(_migrationPath, "r");
+        if (!f) return false;
+        uint32_t data[4] = {0};
+        size_t n = f.read(reinterpret_cast<uint8_t*>(data), sizeof(data));
+        f.close();
+        if (n != sizeof(data) || data[0] != MIGRATION_MAGIC || data[3] != (MIGRATION_MAGIC ^ data[1] ^ (data[2] << 1))) return false;
+        fromBaud = data[1];
+        toBaud = data[2];
+        return true;
+    }
+
+    bool clearMigration() { return mount() && (!LittleFS.exists(_migrationPath) || LittleFS.remove(_migrationPath)); }
+
+private:
+    static constexpr uint32_t MAGIC = 0x504D5352;  // "RSMP"
+    static constexpr uint32_t MIGRATION_MAGIC = 0x47494D52;  // "RMIG"
+
+    struct FileData {
+        uint32_t magic = 0;
+        RS485AddressMap map;
+        uint32_t checksum = 0;
+    };
+
+    char _path[24];
+    char _migrationPath[24];
+
+    // LittleFS may not be mounted yet this early in setup()
+    static bool mount() { return LittleFS.begin(true); }
+
+    // FNV-1a over the fields (not the struct, its padding isn't initialized)
+    static uint32_t checksum(const RS485AddressMap& map) {
+        uint32_t sum = 0x811C9DC5;
+        for (int i = 0; i < 4; ++i) sum = (sum ^ ((map.baud >> (8 * i)) & 0xFF)) * 0x01000193;
+        sum = (sum ^ (map.gapMs & 0xFF)) * 0x01000193;
+        sum = (sum ^ (map.gapMs >> 8)) * 0x01000193;
+        sum = (sum ^ map.roleCount) * 0x01000193;
+        for (uint8_t i = 0; i < RS485AddressMap::MAX_ROLES; ++i) sum = (sum ^ map.addr[i]) * 0x01000193;
+        return sum;
+    }
+};
@@ -0,0 +1,249 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "SHTManager_RS485.h"
+#include "SensorRegistry.h"
+
+/**
+ * RS485BusGroup
+ *
+ * The controller's RS485 buses seen as one set of sensor roles. Each bus
+ * (an SHTManager_RS485 on its own UART and DE pin) runs its own acquisition
+ * task, transaction state machine and statistics, so the buses sample
+ * concurrently and bus time grows with the number of buses instead of every
+ * sensor queueing on one half-duplex line.
+ *
+ * A role is served by the bus that has an address for it. moveRole() (or the
+ * systemConfig "rs485Buses" object) hands a role to another bus; both buses
+ * persist the change in their address maps, so it survives reboots.
+ *
+ * Configuration calls are for loop() / setup(); the getters are safe from any task.
+ */
+
+class RS485BusGroup {
+public:
+    typedef SHTManager_RS485::SensorIndex SensorIndex;
+    static constexpr uint8_t MAX_BUSES = 3;   // UARTs on the ESP32-S3
+
+    bool addBus(SHTManager_RS485& bus) {
+        if (_busCount >= MAX_BUSES || bus.getBusId() != _busCount) return false;
+        _buses[_busCount++] = &bus;
+        return true;
+    }
+
+    uint8_t busCount() const { return _busCount; }
+    SHTManager_RS485* bus(uint8_t id) const { return id < _busCount ? _buses[id] : nullptr; }
+
+    // Bus serving a role, nullptr if no bus has an address for it
+    SHTManager_RS485* owner(SensorIndex idx) const {
+        for (uint8_t b = 0; b < _busCount; ++b) {
+            if (_buses[b]->ownsRole(idx)) return _buses[b];
+        }
+        return nullptr;
+    }
+
+    // Factory address of a role on the first bus (until an address map exists)
+    void setSensorAddr(SensorIndex idx, uint8_t addr) {
+        if (_busCount) _buses[0]->setSensorAddr(idx, addr);
+    }
+
+    // The last buses start first: a role they own from their address map is
+    // dropped from the factory addresses of the buses before them. A role still
+    // claimed by two maps stays on the later bus.
+    void beginWithAddressMap(long defaultBaud = RS485_BAUD_RATE) {
+        for (int b = _busCount - 1; b >= 0; --b) {
+            for (int i = 0; i < SHTManager_RS485::sensorCount(); ++i) {
+                SensorIndex idx = static_cast<SensorIndex>(i);
+                if (ownedAfter(idx, b)) _buses[b]->setSensorAddr(idx, 0);
+            }
+            _buses[b]->beginWithAddressMap(defaultBaud);
+        }
+        for (int i = 0; i < SHTManager_RS485::sensorCount(); ++i) {
+            SensorIndex idx = static_cast<SensorIndex>(i);
+            for (int b = 0; b < _busCount; ++b) {
+                if (_buses[b]->ownsRole(idx) && ownedAfter(idx, b)) {
+                    Serial.printf("[RS485] %s is mapped on bus %d and a later bus, keeping the later one\n",
+                                  SHTManager_RS485::roleName(idx), b);
+                    _buses[b]->assignRole(idx, 0);
+                }
+            }
+        }
+    }
+
+    // One acquisition task per bus
+    bool startTask(BaseType_t core = 0, UBaseType_t priority = 2) {
+        bool ok = true;
+        for (uint8_t b = 0; b < _busCount; ++b) {
+            if (!_buses[b]->startTask(core, priority)) ok = false;
+        }
+        return ok;
+    }
+
+    // Serve a role from another bus (the sensor was rewired), keeping its Modbus
+    // address; run discovery on that bus if the sensor answers at another one.
+    bool moveRole(SensorIndex idx, uint8_t busId) {
+        SHTManager_RS485* to = bus(busId);
+        if (!to) return false;
+        SHTManager_RS485* from = owner(idx);
+        if (from == to) return true;
+        uint8_t addr = from ? from->getSensorAddr(idx) : idx + 1;
+        if (from && !from->assignRole(idx, 0)) return false;
+        if (!to->assignRole(idx, addr)) {
+            if (from) from->assignRole(idx, addr);  // keep serving it where it was
+            return false;
+        }
+        Serial.printf("[RS485] %s moved to bus %u (address %u)\n", SHTManager_RS485::roleName(idx), busId, addr);
+        return true;
+    }
+
+    // {"roof": 1, "room": 0, ...}; returns the number of roles that changed bus
+    int moveRolesFromJson(JsonObjectConst buses) {
+        int moved = 0;
+        for (JsonPairConst kv : buses) {
+            SensorIndex idx;
+            if (!SHTManager_RS485::roleFromName(kv.key().c_str(), idx)) {
+                Serial.printf("[RS485] Unknown role '%s'\n", kv.key().c_str());
+                continue;
+            }
+            int busId = kv.value() | -1;
+            SHTManager_RS485* to = bus(busId);
+            if (!to) {
+                Serial.printf("[RS485] No bus %d for %s\n", busId, kv.key().c_str());
+                continue;
+            }
+            if (owner(idx) != to && moveRole(idx, busId)) ++moved;
+        }
+        return moved;
+    }
+
+    // Bind a role to an address on the bus that serves it (the first bus if none does);
+    // false if that bus is busy
+    bool assignRole(SensorIndex idx, uint8_t addr) {
+        SHTManager_RS485* b = owner(idx);
+        if (!b) b = bus(0);
+        return b && b->assignRole(idx, addr);
+    }
+
+    // ==== Role getters (filtered, NAN if missing or expired) ====
+    float getTemp(SensorIndex idx) const {
+        SHTManager_RS485* b = owner(idx);
+        return b ? b->getTemp(idx) : NAN;
+    }
+
+    float getRH(SensorIndex idx) const {
+        SHTManager_RS485* b = owner(idx);
+        return b ? b->getRH(idx) : NAN;
+    }
+
+    float getAmbiantTemp() const { return getTemp(SHTManager_RS485::AMBIANT); }
+    float getBeforeTemp() const  { return getTemp(SHTManager_RS485::BEFORE); }
+    float getAfterTemp() const   { return getTemp(SHTManager_RS485::AFTER); }
+    float getRoomTemp() const    { return getTemp(SHTManager_RS485::ROOM); }
+    float getRoofTemp() const    { return getTemp(SHTManager_RS485::ROOF); }
+
+    float getAmbiantRH() const   { return getRH(SHTManager_RS485::AMBIANT); }
+    float getBeforeRH() const    { return getRH(SHTManager_RS485::BEFORE); }
+    float getAfterRH() const     { return getRH(SHTManager_RS485::AFTER); }
+    float getRoomRH() const      { return getRH(SHTManager_RS485::ROOM); }
+    float getRoofRH() const      { return getRH(SHTManager_RS485::ROOF); }
+
+    float getRawTemp(SensorIndex idx) const {
+        SHTManager_RS485* b = owner(idx);
+        return b ? b->getRawTemp(idx) : NAN;
+    }
+
+    float getRawRH(SensorIndex idx) const {
+        SHTManager_RS485* b = owner(idx);
+        return b ? b->getRawRH(idx) : NAN;
+    }
+
+    bool readChannel(SensorIndex idx, SensorQuantity quantity, float& value, uint32_t& readMs) const {
+        SHTManager_RS485* b = owner(idx);
+        return b && b->readChannel(idx, quantity, value, readMs);
+    }
+
+    void setBaseInterval(SensorIndex idx, unsigned long intervalMs) {
+        SHTManager_RS485* b = owner(idx);
+        if (b) b->setBaseInterval(idx, intervalMs);
+    }
+
+    bool isWarmedUp() const {
+        for (uint8_t b = 0; b < _busCount; ++b) {
+            if (!_buses[b]->isWarmedUp()) return false;
+        }
+        return true;
+    }
+
+    // Each bus applies the bits of the roles it serves
+    void setPrioritySensors(uint8_t mask) {
+        for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->setPrioritySensors(mask);
+    }
+
+    // ==== Filters (the same settings on every bus) ====
+    void setFilterConfig(const FilterConfig& temp, const FilterConfig& rh) {
+        for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->setFilterConfig(temp, rh);
+    }
+
+    const FilterConfig& getTempFilterConfig() const { return _buses[0]->getTempFilterConfig(); }
+    const FilterConfig& getRHFilterConfig() const { return _buses[0]->getRHFilterConfig(); }
+
+    // Busiest bus, the one that limits polling
+    float getMeasuredBusUtilization() const {
+        float util = 0;
+        for (uint8_t b = 0; b < _busCount; ++b) util = max(util, _buses[b]->getMeasuredBusUtilization());
+        return util;
+    }
+
+    // ==== Telemetry and console ====
+    void statsToJson(JsonObject obj) const {
+        for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->statsToJson(obj);
+    }
+
+    void windowsToJson(JsonObject obj) const {
+        for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->windowsToJson(obj);
+    }
+
+    void printConfig()         { for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->printConfig(); }
+    void printSchedule()       { for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->printSchedule(); }
+    void printFilters() const  { for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->printFilters(); }
+    void printHistory() const  { for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->printHistory(); }
+    void printStats() const    { for (uint8_t b = 0; b < _busCount; ++b) _buses[b]->printStats(); }
+
+private:
+    SHTManager_RS485* _buses[MAX_BUSES] = {nullptr};
+    uint8_t _busCount = 0;
+
+    bool ownedAfter(SensorIndex idx, int busId) const {
+        for (int b = busId + 1; b < _busCount; ++b) {
+            if (_buses[b]->ownsRole(idx)) return true;
+        }
+        return false;
+    }
+};
+
+// SensorRegistry adapter: channel = SensorIndex, served by whichever bus owns the role.
+// Sampling runs in the bus tasks, so no tick().
+class RS485SensorSource : public SensorSource {
+public:
+    explicit RS485SensorSource(RS485BusGroup& buses, const char* name = "rs485")
+        : _buses(buses), _name(name) {}
+
+    const char* name() const override { return _name; }
+
+    bool read(uint16_t channel, SensorQuantity quantity, float& value, uint32_t& readMs) const override {
+        if (channel >= SHTManager_RS485::sensorCount()) return false;
+        return _buses.readChannel(static_cast<SHTManager_RS485::SensorIndex>(channel), quantity, value, readMs);
+    }
+
+    void setInterval(uint16_t channel, uint32_t intervalMs) override {
+        if (channel < SHTManager_RS485::sensorCount()) {
+            _buses.setBaseInterval(static_cast<SHTManager_RS485::SensorIndex>(channel), intervalMs);
+        }
+    }
+
+    float busUtilization() const override { return _buses.getMeasuredBusUtilization(); }
+
+private:
+    RS485BusGroup& _buses;
+    const char* _name;
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "ModbusTransport.h"
+#include "ModbusCapture.h"
+
+/**
+ * ReplayTransport
+ *
+ * Plays a ModbusCapture back into ModbusRtuClient / SHTManager_RS485 instead
+ * of a UART, so the polling state machine runs against recorded field traffic
+ * without hardware - on a host build, with the clock supplied by the harness
+ * (ManualClock), the run is deterministic.
+ *
+ * Each request the client sends takes the next recorded exchange: the recorded
+ * response bytes (also partial or corrupt ones) become available the recorded
+ * time after the request went out, and an exchange that timed out delivers
+ * nothing more, so retries, timeouts and data expiry happen as they did in the
+ * field. Requests that differ from the recorded ones are counted in
+ * mismatches() - the code under test no longer polls like the captured one.
+ * Past the end of the capture the bus stays silent.
+ */
+
+// Host clock: time only moves when the harness advances it or the code under test sleeps
+class ManualClock : public ModbusClock {
+public:
+    uint32_t nowMs() override { return (uint32_t)(_us / 1000); }
+    uint32_t nowUs() override { return (uint32_t)_us; }
+    void sleepMs(uint32_t ms) override { _us += (uint64_t)ms * 1000; }
+
+    void advanceMs(uint32_t ms) { _us += (uint64_t)ms * 1000; }
+    void advanceUs(uint32_t us) { _us += us; }
+
+private:
+    uint64_t _us = 0;
+};
+
+class ReplayTransport : public ModbusTransport {
+public:
+    ReplayTransport(const uint8_t* capture, size_t size, ModbusClock& clock) : _reader(capture, size), _clock(clock) {}
+
+    bool valid() const { return _reader.valid(); }
+    uint32_t capturedBaud() const { return _reader.baud(); }
+
+    void begin(uint32_t baud) override {
+        _baud = baud ? baud : 1;
+        _rxLen = _rxPos = 0;
+        _awaitingListen = false;
+    }
+
+    void send(const uint8_t* frame, size_t length) override {
+        _sendUs = _clock.nowUs();
+        _frameUs = (uint32_t)((uint64_t)length * 10 * 1000000UL / _baud);  // 8N1
+        _awaitingListen = true;
+        _rxLen = _rxPos = 0;
+        _replyDelayUs = 0;
+
+        ModbusCaptureRecord record;
+        do {
+            if (!_reader.next(record)) {
+                _exhausted = true;
+                return;
+            }
+        } while (record.kind != ModbusCaptureRecord::REQUEST);
+
+        _requests++;
+        _recordedMs = record.time;
+        if (record.length != length || memcmp(record.frame, frame, length) != 0) _mismatches++;
+
+        ModbusCaptureRecord response;
+        if (_reader.peek(response) && response.kind == ModbusCaptureRecord::RESPONSE) {
+            _reader.next(response);
+            _rxLen = response.length < sizeof(_rx) ? response.length : sizeof(_rx);
+            memcpy(_rx, response.frame, _rxLen);
+            _replyDelayUs = response.time;
+        }
+    }
+
+    bool sendDone() override { return _clock.nowUs() - _sendUs >= _frameUs; }
+
+    void listen() override {
+        if (!_awaitingListen) return;
+        _awaitingListen = false;
+        _listenUs = _clock.nowUs();
+    }
+
+    int available() override {
+        if (_awaitingListen || _rxPos >= _rxLen) return 0;
+        if (_clock.nowUs() - _listenUs < _replyDelayUs) return 0;
+        return (int)(_rxLen - _rxPos);
+    }
+
+    int read() override { return available() > 0 ? _rx[_rxPos++] : -1; }
+
+    ModbusClock& clock() override { return _clock; }
+
+    // ==== Replay results ====
+    uint32_t requests() const { return _requests; }       // exchanges replayed
+    uint32_t mismatches() const { return _mismatches; }   // requests that differ from the capture
+    bool exhausted() const { return _exhausted; }         // a request came after the last record
+
+    // When the current request was sent in the field (ms since the capture started)
+    uint32_t recordedMs() const { return _recordedMs; }
+
+    void rewind() {
+        _reader.rewind();
+        _requests = _mismatches = 0;
+        _exhausted = false;
+        _rxLen = _rxPos = 0;
+    }
+
+private:
+    ModbusCapture::Reader _reader;
+    ModbusClock& _clock;
+    uint32_t _baud = 1;
+
+    uint8_t _rx[255];
+    size_t _rxLen = 0;
+    size_t _rxPos = 0;
+    uint32_t _sendUs = 0;
+    uint32_t _frameUs = 0;
+    uint32_t _listenUs = 0;
+    uint32_t _replyDelayUs = 0;
+    bool _awaitingListen = false;
+
+    uint32_t _requests = 0;
+    uint32_t _mismatches = 0;
+    uint32_t _recordedMs = 0;
+    bool _exhausted = false;
+};
@@ -2,6 +2,7 @@
 #include <Arduino.h>
 #include <Adafruit_SHT31.h>
 #include <Wire.h>
+#include "SensorRegistry.h"
 
 // I2C pin definitions
 #define SCL_RIGHT 4
@@ -14,106 +15,87 @@ public:
     // Enum to reference each sensor by logical role
     enum SensorIndex { AMBIANT = 0, BEFORE = 1, AFTER = 2, ROOM = 3 };
 
+    // SINGLE_SHOT starts a conversion for every sample and reads it back once it's done.
+    // In the PERIODIC modes the sensors measure continuously at the given rate (high
+    // repeatability) and a sample is only a fetch of the latest result.
+    enum class Mode { SINGLE_SHOT, PERIODIC_0_5_MPS, PERIODIC_1_MPS, PERIODIC_2_MPS, PERIODIC_4_MPS, PERIODIC_10_MPS };
+
     SHTManager_I2C() {
         // Create Adafruit_SHT31 instances, assigning them to the correct I2C bus
         m_sensors[BEFORE]  = new Adafruit_SHT31(&I2C_BUS_LEFT);
         m_sensors[AFTER]   = new Adafruit_SHT31(&I2C_BUS_LEFT);
         m_sensors[AMBIANT] = new Adafruit_SHT31(&I2C_BUS_RIGHT);
         m_sensors[ROOM]    = new Adafruit_SHT31(&I2C_BUS_RIGHT);
+        m_wire[BEFORE]  = m_wire[AFTER] = &I2C_BUS_LEFT;
+        m_wire[AMBIANT] = m_wire[ROOM]  = &I2C_BUS_RIGHT;
+        m_addr[BEFORE]  = m_addr[AMBIANT] = 0x44;
+        m_addr[AFTER]   = m_addr[ROOM]    = 0x45;
 
         // Initialize sensor data and read timestamps
         for (int i = 0; i < SENSOR_COUNT; ++i) {
             m_temp[i] = NAN;
             m_humid[i] = NAN;
             m_lastReadMs[i] = 0;
+            m_lastValidMs[i] = 0;
+            m_readIntervalMs[i] = SENSOR_READ_INTERVAL_MS;
         }
     }
 
-    // High-level init: setup I2C and sensors, and populate data
+    // High-level init: setup I2C and sensors. Values stay NAN (unknown) until the
+    // first tick() cycle reads them - every sensor is due right away.
     void begin() {
         setup();            // Setup buses and start sensors
-        fillSensorData();   // Read initial temperature + humidity values
+        m_warmupStartMs = millis();
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            m_firstValidMs[i] = 0;
+            m_warmedUp[i] = false;
+        }
     }
 
-    // Non-blocking tick function: progresses one step in the reading process
+    // Non-blocking tick function: progresses each bus's reading process by one step.
+    // The LEFT and RIGHT buses have their own state machines and a step is one short
+    // I2C transfer (a command, or a 6-byte read) - a conversion runs on the sensor
+    // while the tick returns - so the two buses' conversions overlap.
     void tick() {
         unsigned long now = millis();
+        for (int b = 0; b < BUS_COUNT; ++b) tickBus(m_buses[b], now);
+    }
 
-        switch (m_status) {
-            case ReadStatus::IDLE:
-                // Check if it's time to read the current sensor
-                if (now - m_lastReadMs[m_currentSensor] >= SENSOR_READ_INTERVAL_MS) {
-                    // Start reading temperature first
-                    m_readType = ReadType::TEMP;
-                    m_status = ReadStatus::WAITING;
-                    m_retryCount = 0;
-                    m_opTimestamp = now;
-                } else {
-                    // If not ready, move to the next sensor
-                    m_currentSensor = static_cast<SensorIndex>((m_currentSensor + 1) % SENSOR_COUNT);
-                }
-                break;
-
-            case ReadStatus::WAITING:
-                // Wait a short time between reads to avoid I2C timing issues
-                if (now - m_opTimestamp >= SENSOR_WAIT_MS) {
-                    Adafruit_SHT31* sensor = m_sensors[m_currentSensor];
-                    float value = NAN;
-
-                    if (m_readType == ReadType::TEMP) {
-                        // Read temperature from sensor
-                        value = sensor->readTemperature();
-                        if (!isnan(value)) {
-                            m_temp[m_currentSensor] = value;
-                            m_readType = ReadType::HUMID;  // Move to humidity reading
-                            m_retryCount = 0;
-                        } else if (++m_retryCount < MAX_RETRIES) {
-                            // Retry if reading failed
-                            m_opTimestamp = now;
-                            return;
-                        } else {
-                            // Failed after retries
-                            //Serial.printf("Failed to read temperature from sensor %d\n", m_currentSensor);
-                            m_retryCount = 0;
-                            m_readType = ReadType::HUMID;  // Still attempt RH
-                        }
-                        m_opTimestamp = now;
-                    } else if (m_readType == ReadType::HUMID) {
-                        // Read humidity from sensor
-                        value = sensor->readHumidity();
-                        if (!isnan(value)) {
-                            m_humid[m_currentSensor] = value;
-                        } else if (++m_retryCount < MAX_RETRIES) {
-                            m_opTimestamp = now;
-                            return;
-                        } else {
-                            //Serial.printf("Failed to read humidity from sensor %d\n", m_currentSensor);
-                        }
-
-                        // Mark this sensor as updated
-                        m_lastReadMs[m_currentSensor] = now;
-                        m_currentSensor = static_cast<SensorIndex>((m_currentSensor + 1) % SENSOR_COUNT);
-                        m_status = ReadStatus::IDLE;
-                        m_retryCount = 0;
-                    }
-                }
-                break;
+    // Switch acquisition mode; before begin() it's only stored. Afterwards it takes effect on
+    // the sensors right away: periodic measurement is stopped or (re)started.
+    void setMode(Mode mode) {
+        m_mode = mode;
+        if (!m_begun) return;
+        for (int i = 0; i < SENSOR_COUNT; ++i) startMode(static_cast<SensorIndex>(i));
+        for (int b = 0; b < BUS_COUNT; ++b) m_buses[b].status = ReadStatus::IDLE;
+    }
+
+    Mode getMode() const { return m_mode; }
+    bool isPeriodic() const { return m_mode != Mode::SINGLE_SHOT; }
+
+    // Fastest useful read interval in the current mode (a fetch returns each result once)
+    unsigned long getMinReadInterval() const {
+        switch (m_mode) {
+            case Mode::PERIODIC_0_5_MPS: return 2000;
+            case Mode::PERIODIC_1_MPS:   return 1000;
+            case Mode::PERIODIC_2_MPS:   return 500;
+            case Mode::PERIODIC_4_MPS:   return 250;
+            case Mode::PERIODIC_10_MPS:  return 100;
+            default:                     return SENSOR_WAIT_MS;
         }
     }
 
     // Fill all sensor readings immediately (blocking)
     void fillSensorData() {
         for (int i = 0; i < SENSOR_COUNT; ++i) {
-            Adafruit_SHT31* sensor = m_sensors[i];
-
-            float temp = sensor->readTemperature();
-            delay(50);
-            float humid = sensor->readHumidity();
-            delay(50);
+            float temp = NAN, humid = NAN;
+            if (!measure(static_cast<SensorIndex>(i), temp, humid)) temp = humid = NAN;
+            delay(isPeriodic() ? getMinReadInterval() / SENSOR_COUNT : 50);
 
-            m_temp[i] = !isnan(temp) ? temp : NAN;
-            m_humid[i] = !isnan(humid) ? humid : NAN;
+            m_temp[i] = temp;
+            m_humid[i] = humid;
             m_lastReadMs[i] = millis();
+            if (!isnan(temp)) m_lastValidMs[i] = m_lastReadMs[i] ? m_lastReadMs[i] : 1;
 
             Serial.printf("Sensor %d boot read - Temp: %.1f°C, RH: %.1f%%\n", i, m_temp[i], m_humid[i]);
         }
@@ -130,15 +112,46 @@ public:
     float getRoomTemp()     { return m_temp[ROOM]; }
     float getRoomRH()       { return m_humid[ROOM]; }
 
+    // True once every sensor had its first read attempt
+    bool isWarmedUp() const {
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!m_warmedUp[i]) return false;
+        }
+        return true;
+    }
+
+    // ms from begin() to the sensor's first valid reading, 0 if there was none yet
+    unsigned long getTimeToFirstValid(SensorIndex idx) const { return m_firstValidMs[idx]; }
+
+    static constexpr int sensorCount() { return SENSOR_COUNT; }
+    void setReadInterval(SensorIndex idx, unsigned long intervalMs) { m_readIntervalMs[idx] = intervalMs; }
+
+    // Cached value and time of the last good read, false if missing or expired (SensorRegistry)
+    bool readChannel(SensorIndex idx, SensorQuantity quantity, float& value, uint32_t& readMs) const {
+        if (!m_lastValidMs[idx] || millis() - m_lastValidMs[idx] > DATA_EXPIRY_MS) return false;
+        value = quantity == SensorQuantity::Humidity ? m_humid[idx] : m_temp[idx];
+        readMs = m_lastValidMs[idx];
+        return !isnan(value);
+    }
+
 private:
     // ==== Constants and types ====
     static constexpr int SENSOR_COUNT = 4;
+    static constexpr int BUS_COUNT = 2;
+    static constexpr int SENSORS_PER_BUS = 2;
     static constexpr int MAX_RETRIES = 3;
     static constexpr unsigned long SENSOR_READ_INTERVAL_MS = 60000;  // 1 minute between reads per sensor
     static constexpr unsigned long SENSOR_WAIT_MS = 200;             // Delay between read attempts
+    static constexpr unsigned long CONVERSION_MS = 16;               // single shot, high repeatability: 15.5ms max
+    static constexpr unsigned long DATA_EXPIRY_MS = 300000;          // 5 minutes - data expires after this time
+
+    // SHT3x commands (datasheet, section 4); periodic ones are high repeatability
+    static constexpr uint16_t CMD_SINGLE_SHOT = 0x2400;        // no clock stretching
+    static constexpr uint16_t CMD_FETCH_DATA = 0xE000;
+    static constexpr uint16_t CMD_BREAK = 0x3093;              // stop periodic measurement
 
-    enum class ReadStatus { IDLE, WAITING };
-    enum class ReadType { TEMP, HUMID };
+    // CONVERTING: measurement started (or, periodic, due for a fetch); RETRY_WAIT: after a failed attempt
+    enum class ReadStatus { IDLE, CONVERTING, RETRY_WAIT };
 
     // ==== I2C buses ====
     TwoWire I2C_BUS_LEFT = TwoWire(0);
@@ -146,18 +159,116 @@ private:
 
     // ==== Sensor objects ====
     Adafruit_SHT31* m_sensors[SENSOR_COUNT];
+    TwoWire* m_wire[SENSOR_COUNT];
+    uint8_t m_addr[SENSOR_COUNT];
+    Mode m_mode = Mode::SINGLE_SHOT;
+    bool m_begun = false;
 
     // ==== Cached sensor data ====
     float m_temp[SENSOR_COUNT];
     float m_humid[SENSOR_COUNT];
-    unsigned long m_lastReadMs[SENSOR_COUNT];
+    unsigned long m_lastReadMs[SENSOR_COUNT];   // last read attempt
+    unsigned long m_lastValidMs[SENSOR_COUNT];  // last good read, 0 if none
+    unsigned long m_readIntervalMs[SENSOR_COUNT];
+
+    // ==== Warm-up ====
+    unsigned long m_warmupStartMs = 0;
+    unsigned long m_firstValidMs[SENSOR_COUNT] = {0};
+    bool m_warmedUp[SENSOR_COUNT] = {false};
+
+    // ==== Tick state machines, one per bus ====
+    struct BusState {
+        SensorIndex sensors[SENSORS_PER_BUS];
+        int current = 0;                    // index into sensors
+        ReadStatus status = ReadStatus::IDLE;
+        int retryCount = 0;
+        unsigned long opTimestamp = 0;
+        unsigned long waitMs = 0;           // from opTimestamp until the result can be read
+
+        BusState(SensorIndex first, SensorIndex second) : sensors{first, second} {}
+    };
+
+    BusState m_buses[BUS_COUNT] = {
+        BusState(BEFORE, AFTER),    // LEFT
+        BusState(AMBIANT, ROOM)     // RIGHT
+    };
+
+    // One step of a bus's state machine
+    void tickBus(BusState& bus, unsigned long now) {
+        SensorIndex idx = bus.sensors[bus.current];
+
+        switch (bus.status) {
+            case ReadStatus::IDLE:
+                // Check if it's time to read the current sensor
+                if (!m_warmedUp[idx] || now - m_lastReadMs[idx] >= m_readIntervalMs[idx]) {
+                    bus.retryCount = 0;
+                    startMeasurement(bus, idx, now);
+                } else {
+                    // If not ready, move to the next sensor on this bus
+                    bus.current = (bus.current + 1) % SENSORS_PER_BUS;
+                }
+                return;
+
+            case ReadStatus::CONVERTING: {
+                if (now - bus.opTimestamp < bus.waitMs) return;
+
+                // Temperature and humidity come from one measurement
+                float temp = NAN, humid = NAN;
+                bool ok = isPeriodic() ? fetch(idx, temp, humid) : readResult(idx, temp, humid);
+                if (ok) finishRead(bus, idx, true, temp, humid, now);
+                else retryOrGiveUp(bus, idx, now);
+                return;
+            }
+
+            case ReadStatus::RETRY_WAIT:
+                // Wait a short time between attempts to avoid I2C timing issues
+                if (now - bus.opTimestamp >= SENSOR_WAIT_MS) startMeasurement(bus, idx, now);
+                return;
+        }
+    }
+
+    // Single shot: send the command, the result is read CONVERSION_MS later.
+    // Periodic: the sensor is measuring already, the fetch can go right away.
+    void startMeasurement(BusState& bus, SensorIndex idx, unsigned long now) {
+        if (!isPeriodic() && !writeCommand(idx, CMD_SINGLE_SHOT)) {
+            retryOrGiveUp(bus, idx, now);
+            return;
+        }
+        bus.status = ReadStatus::CONVERTING;
+        bus.opTimestamp = now;
+        bus.waitMs = isPeriodic() ? 0 : CONVERSION_MS;
+    }
+
+    void retryOrGiveUp(BusState& bus, SensorIndex idx, unsigned long now) {
+        if (++bus.retryCount < MAX_RETRIES) {
+            bus.status = ReadStatus::RETRY_WAIT;
+            bus.opTimestamp = now;
+            return;
+        }
+        // A sensor that lost power is back in single-shot mode - restart its measurement
+        if (isPeriodic()) startMode(idx);
+        finishRead(bus, idx, false, NAN, NAN, now);
+    }
 
-    // ==== Tick state machine ====
-    SensorIndex m_currentSensor = AMBIANT;
-    ReadStatus m_status = ReadStatus::IDLE;
-    ReadType m_readType = ReadType::TEMP;
-    int m_retryCount = 0;
-    unsigned long m_opTimestamp = 0;
+    void finishRead(BusState& bus, SensorIndex idx, bool ok, float temp, float humid, unsigned long now) {
+        if (ok) {
+            m_temp[idx] = temp;
+            m_humid[idx] = humid;
+            m_lastValidMs[idx] = now ? now : 1;
+        }
+
+        // Mark this sensor as updated
+        m_lastReadMs[idx] = now;
+        m_warmedUp[idx] = true;
+        if (!m_firstValidMs[idx] && !isnan(m_temp[idx]) && !isnan(m_humid[idx])) {
+            unsigned long elapsed = now - m_warmupStartMs;
+            m_firstValidMs[idx] = elapsed ? elapsed : 1;
+            Serial.printf("Sensor %d first valid reading after %lums\n", idx, elapsed);
+        }
+        bus.current = (bus.current + 1) % SENSORS_PER_BUS;
+        bus.status = ReadStatus::IDLE;
+        bus.retryCount = 0;
+    }
 
     // ==== Setup function ====
     // This function initializes the I2C buses and begins communication with each sensor
@@ -175,5 +286,102 @@ private:
         delay(50);
         m_sensors[ROOM]->begin(0x45);
         delay(50);
+
+        m_begun = true;
+        for (int i = 0; i < SENSOR_COUNT; ++i) startMode(static_cast<SensorIndex>(i));
+    }
+
+    // ==== Measurement ====
+    static uint16_t periodicCommand(Mode mode) {
+        switch (mode) {
+            case Mode::PERIODIC_0_5_MPS: return 0x2032;
+            case Mode::PERIODIC_1_MPS:   return 0x2130;
+            case Mode::PERIODIC_2_MPS:   return 0x2236;
+            case Mode::PERIODIC_4_MPS:   return 0x2334;
+            case Mode::PERIODIC_10_MPS:  return 0x2737;
+            default:                     return 0;
+        }
+    }
+
+    // Stop any periodic measurement, then start the configured one
+    bool startMode(SensorIndex idx) {
+        writeCommand(idx, CMD_BREAK);
+        delay(1);  // the break takes up to 1ms before the next command is accepted
+        if (!isPeriodic()) return true;
+        bool ok = writeCommand(idx, periodicCommand(m_mode));
+        if (!ok) Serial.printf("Sensor %d didn't accept periodic mode\n", idx);
+        return ok;
+    }
+
+    // Blocking read (boot only)
+    bool measure(SensorIndex idx, float& temp, float& humid) {
+        if (isPeriodic()) return fetch(idx, temp, humid);
+        if (!writeCommand(idx, CMD_SINGLE_SHOT)) return false;
+        delay(CONVERSION_MS);
+        return readResult(idx, temp, humid);
+    }
+
+    bool writeCommand(SensorIndex idx, uint16_t cmd) {
+        TwoWire* wire = m_wire[idx];
+        wire->beginTransmission(m_addr[idx]);
+        wire->write((uint8_t)(cmd >> 8));
+        wire->write((uint8_t)(cmd & 0xFF));
+        return wire->endTransmission() == 0;
     }
+
+    // Latest periodic result; the sensor NACKs the read if there is none since the last fetch
+    bool fetch(SensorIndex idx, float& temp, float& humid) {
+        return writeCommand(idx, CMD_FETCH_DATA) && readResult(idx, temp, humid);
+    }
+
+    // Measurement result: temperature and humidity words, each with its CRC. The sensor
+    // NACKs while a single-shot conversion is still running.
+    bool readResult(SensorIndex idx, float& temp, float& humid) {
+        TwoWire* wire = m_wire[idx];
+        uint8_t data[6];
+        if (wire->requestFrom(m_addr[idx], (uint8_t)sizeof(data)) != sizeof(data)) return false;
+        for (size_t i = 0; i < sizeof(data); ++i) data[i] = wire->read();
+        if (crc8(data, 2) != data[2] || crc8(data + 3, 2) != data[5]) return false;
+
+        uint16_t rawTemp = ((uint16_t)data[0] << 8) | data[1];
+        uint16_t rawHumid = ((uint16_t)data[3] << 8) | data[4];
+        temp = -45.0f + 175.0f * rawTemp / 65535.0f;
+        humid = 100.0f * rawHumid / 65535.0f;
+        return true;
+    }
+
+    // CRC-8, polynomial 0x31, init 0xFF (datasheet, section 4.12)
+    static uint8_t crc8(const uint8_t* data, int length) {
+        uint8_t crc = 0xFF;
+        for (int i = 0; i < length; ++i) {
+            crc ^= data[i];
+            for (int b = 0; b < 8; ++b) crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+        return crc;
+    }
+};
+
+// SensorRegistry adapter: channel = SensorIndex; reads are driven by the registry's tick()
+class I2CSensorSource : public SensorSource {
+public:
+    explicit I2CSensorSource(SHTManager_I2C& manager, const char* name = "i2c")
+        : m_manager(manager), m_name(name) {}
+
+    const char* name() const override { return m_name; }
+    void tick() override { m_manager.tick(); }
+
+    bool read(uint16_t channel, SensorQuantity quantity, float& value, uint32_t& readMs) const override {
+        if (channel >= SHTManager_I2C::sensorCount()) return false;
+        return m_manager.readChannel(static_cast<SHTManager_I2C::SensorIndex>(channel), quantity, value, readMs);
+    }
+
+    void setInterval(uint16_t channel, uint32_t intervalMs) override {
+        if (channel < SHTManager_I2C::sensorCount()) {
+            m_manager.setReadInterval(static_cast<SHTManager_I2C::SensorIndex>(channel), intervalMs);
+        }
+    }
+
+private:
+    SHTManager_I2C& m_manager;
+    const char* m_name;
 };
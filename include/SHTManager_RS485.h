@@ -1,6 +1,12 @@
 #pragma once
 #include <Arduino.h>
-#include <ModbusMaster.h>
+#include <ArduinoJson.h>
+#include "ModbusRtuClient.h"
+#include "SensorSnapshot.h"
+#include "SampleHistory.h"
+#include "SensorFilter.h"
+#include "SensorRegistry.h"
+#include "RS485AddressMap.h"
 
 // Pin definitions for RS485
 #define RS485_RX_PIN    16 // RO
@@ -9,42 +15,196 @@
 // A -> Yellow, B -> Blue
 #define RS485_BAUD_RATE 4800 // Default baud rate for RS485 communication
 
+// Second RS485 bus (UART1), for installations with more measurement points
+#define RS485_2_RX_PIN    41
+#define RS485_2_TX_PIN    42
+#define RS485_2_DE_RE_PIN 2
+
+// One RS485 bus: its UART, transaction state machine, statistics and address map.
+// Every bus instance polls in its own task, so buses sample concurrently. A role
+// belongs to the bus that has an address for it; the others keep address 0 for it
+// (see RS485BusGroup, which routes the role getters to the owning bus).
 class SHTManager_RS485 {
 public:
     enum SensorIndex { AMBIANT = 0, BEFORE = 1, AFTER = 2, ROOM = 3, ROOF = 4 };
 
-    SHTManager_RS485(HardwareSerial& serialPort)
-        : _serial(serialPort) {
+    // COMBINED reads RH (0x0000) and temperature (0x0001) in one transaction,
+    // SEPARATE issues one request per register with the inter-frame gap in between
+    enum class ReadMode { COMBINED, SEPARATE };
+
+    // Attempts per sensor and sampling round, and how long a good reading stays valid
+    static constexpr int MAX_RETRIES = 3;
+    static constexpr unsigned long DATA_EXPIRY_MS = 300000; // 5 minutes - data expires after this time
+
+    // The transport is the bus's UART (UartTransport), or a ReplayTransport to run against a capture
+    explicit SHTManager_RS485(ModbusTransport& transport, uint8_t busId = 0)
+        : _bus(transport), _clock(transport.clock()), _busId(busId), _mapStore(busId) {
+        if (busId == 0) snprintf(_tag, sizeof(_tag), "[RS485]");
+        else snprintf(_tag, sizeof(_tag), "[RS485.%u]", busId);
         for (int i = 0; i < SENSOR_COUNT; ++i) {
-            _modbus[i] = new ModbusMaster();
-            _sensorAddr[i] = i + 1; // Default: 1=Ambiant, 2=Before, 3=After, 4=Room
+            // Default: 1=Ambiant, 2=Before, 3=After, 4=Room on the first bus, nothing on the others
+            _sensorAddr[i] = busId == 0 ? i + 1 : 0;
             _lastTemp[i] = NAN;
             _lastRH[i] = NAN;
             _lastReadMs[i] = 0;
+            _quality[i] = SensorQuality::Missing;
+            _tempHistory[i].setWindow(HISTORY_WINDOW_MS);
+            _rhHistory[i].setWindow(HISTORY_WINDOW_MS);
         }
+        _tempFilterConfig.maxRatePerMin = TEMP_MAX_RATE_PER_MIN;
+        _rhFilterConfig.maxRatePerMin = RH_MAX_RATE_PER_MIN;
     }
 
     void begin(long baud = RS485_BAUD_RATE) {
-        _serial.begin(baud, SERIAL_8N1, RS485_RX_PIN, RS485_TX_PIN);
-        pinMode(RS485_DE_RE_PIN, OUTPUT);
-        digitalWrite(RS485_DE_RE_PIN, LOW);
+        if (!_busMutex) _busMutex = xSemaphoreCreateMutex();
+        BusLock lock(_busMutex, LOOP_LOCK_TICKS);  // 'shtbaud' calls it from loop()
+        if (!lock) {
+            busBusy("baud change");
+            return;
+        }
+        _baud = baud;
+        openBus(baud);
+        _statsSinceMs = _clock.nowMs();
+        restartWarmup(); // the first acquisition cycle fills the values in the background
+    }
+
+    // Boot from the persisted address map: the warm-up cycle doubles as a one-pass
+    // verification of every role. Without a map the factory addresses (setSensorAddr)
+    // are probed, and only if some don't answer is the likely address range discovered;
+    // that runs in the acquisition task once startTask() is called, so a missing
+    // sensor doesn't hold up setup().
+    void beginWithAddressMap(long defaultBaud = RS485_BAUD_RATE) {
+        RS485AddressMap map;
+        bool haveMap = _mapStore.load(map) && map.roleCount == SENSOR_COUNT;
+        if (haveMap) {
+            for (int i = 0; i < SENSOR_COUNT; ++i) _sensorAddr[i] = map.addr[i];
+            defaultBaud = map.baud;
+            if (map.gapMs) _gapMs = map.gapMs;
+        }
+
+        begin(defaultBaud);
+
+        if (haveMap) {
+            Serial.printf("%s Address map loaded: %ld baud, gap %lums, verifying during warm-up\n", _tag, _baud, _gapMs);
+            uint32_t from, to;
+            if (_mapStore.loadMigration(from, to)) {
+                Serial.printf("%s Baud migration %lu -> %lu was interrupted, recovering in the acquisition task\n", _tag, from, to);
+                _jobs.fetch_or(JOB_RECOVER_BAUD);
+            }
+            return;
+        }
+
+        Serial.printf("%s No address map, verifying the factory addresses in the acquisition task\n", _tag);
+        _jobs.fetch_or(JOB_COMMISSION);
+    }
+
+    // Probe the likely address range (1..LIKELY_MAX_ADDR) at every common baud rate,
+    // then the rest of the range if fullRange and sensors are still missing. A role is
+    // only verified when a device answers at its own address; the other devices are
+    // listed but never bound to a role by guess - control decides on these values, so
+    // that takes 'shtrole'. The address map is saved once every role is verified.
+    // From loop() it gives up if the bus stays busy (a tune) for lockWait.
+    bool discoverAndAssign(bool fullRange, TickType_t lockWait = LOOP_LOCK_TICKS) {
+        BusLock lock(_busMutex, lockWait);
+        if (!lock) return busBusy("discovery");
+        DiscoveryResult found;
+        if (discover(found, fullRange) == 0) {
+            Serial.printf("%s Discovery found no devices, keeping the current addresses\n", _tag);
+            openBus(_baud);
+            return false;
+        }
+        _baud = found.baud;
+        openBus(_baud);
+        if (verifyRoles(found)) {
+            saveAddressMap();
+        } else {
+            Serial.printf("%s Address map not saved until every role is bound\n", _tag);
+        }
+        restartWarmup();
+        return true;
+    }
+
+    // Manually bind a role to an address (e.g. a device discovery listed as unbound);
+    // address 0 hands the role to another bus. The role starts over: its values,
+    // filters and history are dropped and it gets a warm-up read. False if the
+    // bus stayed busy (a tune) - nothing changed then.
+    bool assignRole(SensorIndex idx, uint8_t addr) {
+        BusLock lock(_busMutex, LOOP_LOCK_TICKS);
+        if (!lock) return busBusy(roleName(idx));
+        _sensorAddr[idx] = addr;
+        saveAddressMap();
+        if (addr) _warmupPending.fetch_or(1 << idx, std::memory_order_relaxed);
+        _roleReset.fetch_or(1 << idx, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Record every Modbus exchange of this bus (ModbusFrameRecorder); nullptr to stop.
+    // False if the bus stayed busy (a tune).
+    bool setFrameSink(ModbusFrameSink* sink) {
+        BusLock lock(_busMutex, LOOP_LOCK_TICKS);
+        if (!lock) return busBusy("capture");
+        _bus.setFrameSink(sink);
+        return true;
+    }
+
+    long getBaud() const { return _baud; }
+
+    // ==== Bus membership ====
+    uint8_t getBusId() const { return _busId; }
+    bool ownsRole(SensorIndex idx) const { return _sensorAddr[idx] != 0; }
+    uint8_t getSensorAddr(SensorIndex idx) const { return _sensorAddr[idx]; }
+
+    int ownedCount() const {
+        int count = 0;
         for (int i = 0; i < SENSOR_COUNT; ++i) {
-            _modbus[i]->begin(_sensorAddr[i], _serial);
-            _modbus[i]->preTransmission(preTransmission);
-            _modbus[i]->postTransmission(postTransmission);
+            if (ownsRole(static_cast<SensorIndex>(i))) ++count;
         }
-        fillSensorData(); // Initial read to populate data
+        return count;
+    }
+
+    // ==== Warm-up ====
+    // True once every sensor had its first read attempt since begin() / discovery
+    bool isWarmedUp() const { return _warmupPending.load(std::memory_order_relaxed) == 0; }
+
+    // ms from begin() to the sensor's first valid reading, 0 if there was none yet
+    uint32_t getTimeToFirstValid(SensorIndex idx) const { return _firstValidMs[idx]; }
+
+    // Run tick() in its own task, so sampling doesn't depend on how busy loop() is.
+    // Call after begin(); loop() must not call tick() afterwards.
+    bool startTask(BaseType_t core = 0, UBaseType_t priority = 2) {
+        if (_task) return true;
+        char name[16];
+        snprintf(name, sizeof(name), "rs485_acq%u", _busId);
+        return xTaskCreatePinnedToCore(acquisitionTask, name, TASK_STACK, this, priority, &_task, core) == pdPASS;
     }
 
+    // Never blocks: a request is started here and completed on later ticks
     void tick() {
-        unsigned long now = millis();
+        unsigned long now = _clock.nowMs();
 
         switch (_status) {
             case ReadStatus::IDLE:
-                if (now - _lastReadMs[_currentSensorIndex] >= _sensorReadIntervalMs[_currentSensorIndex]) {
+                if (_historyReset.exchange(false)) {
+                    for (int i = 0; i < SENSOR_COUNT; ++i) {
+                        _tempHistory[i].clear();
+                        _rhHistory[i].clear();
+                        _tempFilter[i].reset();
+                        _rhFilter[i].reset();
+                    }
+                }
+                applyFilterConfig();
+                resetRoles(_roleReset.exchange(0));
+                if (!ownsRole(static_cast<SensorIndex>(_currentSensorIndex))) {
+                    _currentSensorIndex = (_currentSensorIndex + 1) % SENSOR_COUNT;  // on another bus
+                } else if (isWarmingUp(_currentSensorIndex) ||
+                    now - _lastAttemptMs[_currentSensorIndex] >= effectiveInterval(_currentSensorIndex)) {
                     // It's time to update this sensor
                     _opTimestamp = now;
-                    _currentRead = ReadType::TEMP;
+                    _cycleBusyMs = 0;
+                    _prevTemp = _lastTemp[_currentSensorIndex];
+                    _prevRH = _lastRH[_currentSensorIndex];
+                    _prevReadMs = _lastReadMs[_currentSensorIndex];
+                    _currentRead = (_readMode == ReadMode::COMBINED) ? ReadType::BOTH : ReadType::TEMP;
                     _status = ReadStatus::WAITING;
                 } else {
                     // Not time yet → check next sensor
@@ -53,133 +213,516 @@ public:
                 break;
 
             case ReadStatus::WAITING:
-                if (now - _opTimestamp >= SENSOR_WAIT_MS) {
-                    if (_currentRead == ReadType::TEMP) {
-                        float value = readTemperature(static_cast<SensorIndex>(_currentSensorIndex));
-                        if (value == NAN) {
-                            // If read failed, retry up to MAX_RETRIES
-                            if (++_retryCount < MAX_RETRIES) {
-                                _opTimestamp = now; // Reset timer for retry
-                                return; // Wait for next tick
-                            } else {
-                                Serial.printf("Failed to read temperature from sensor %d after %d retries\n", _currentSensorIndex, MAX_RETRIES);
-                                _retryCount = 0; // Reset retry count
-                            }
-                        } else {
-                            _lastTemp[_currentSensorIndex] = value;
-                            _retryCount = 0; // Reset retry count on success
-                        }
-                        
-                        _currentRead = ReadType::HUMID;
-                        _opTimestamp = now;  // restart timer before next read
-                    }
-                    else if (_currentRead == ReadType::HUMID) {
-                        float value = readHumidity(static_cast<SensorIndex>(_currentSensorIndex));
-                        if(value == NAN) {
-                            // If read failed, retry up to MAX_RETRIES
-                            if (++_retryCount < MAX_RETRIES) {
-                                _opTimestamp = now; // Reset timer for retry
-                                return; // Wait for next tick
-                            } else {
-                                Serial.printf("Failed to read humidity from sensor %d after %d retries\n", _currentSensorIndex, MAX_RETRIES);
-                                _retryCount = 0; // Reset retry count
-                            }
-                        } else {
-                            _lastRH[_currentSensorIndex] = value;
-                            _retryCount = 0; // Reset retry count on success
-                            // Update last read time only on successful read
-                            _lastReadMs[_currentSensorIndex] = now;
-                        }
-
-                        _currentSensorIndex = (_currentSensorIndex + 1) % SENSOR_COUNT;
-                        _status = ReadStatus::IDLE;
+                if (!ownsRole(static_cast<SensorIndex>(_currentSensorIndex))) {
+                    // Handed to another bus between requests
+                    _retryCount = 0;
+                    _currentSensorIndex = (_currentSensorIndex + 1) % SENSOR_COUNT;
+                    _status = ReadStatus::IDLE;
+                    break;
+                }
+                if (now - _opTimestamp >= _gapMs) {
+                    // The bus is held for one transaction at a time; commissioning commands wait for it
+                    if (_busMutex && xSemaphoreTake(_busMutex, 0) != pdTRUE) break;
+                    if (startRead(static_cast<SensorIndex>(_currentSensorIndex), _currentRead)) {
+                        _busyStartMs = now;
+                        _status = ReadStatus::BUSY;
+                    } else if (_busMutex) {
+                        xSemaphoreGive(_busMutex);
                     }
                 }
                 break;
+
+            case ReadStatus::BUSY: {
+                ModbusResult result = _bus.poll();
+                if (result == ModbusResult::Pending) break;
+                if (_busMutex) xSemaphoreGive(_busMutex);
+                _cycleBusyMs += now - _busyStartMs;
+                recordResult(_currentSensorIndex, result, now - _busyStartMs, now);
+                onReadComplete(result == ModbusResult::Success, now);
+                break;
+            }
         }
     }
 
     // Fill the sensor data (usealy for first time setup)
     void fillSensorData() {
-        unsigned long now = millis();
         for (int i = 0; i < SENSOR_COUNT; ++i) {
-            _lastTemp[i] = readTemperature(static_cast<SensorIndex>(i));
-            delay(30); // Small delay to avoid flooding the bus
-            _lastRH[i] = readHumidity(static_cast<SensorIndex>(i));
-            delay(30); // Small delay to avoid flooding the bus
-            _lastReadMs[i] = now;
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            float temp, rh;
+            if (_readMode == ReadMode::COMBINED) {
+                readBoth(static_cast<SensorIndex>(i), temp, rh);
+            } else {
+                temp = readTemperature(static_cast<SensorIndex>(i));
+                _clock.sleepMs(30); // Small delay to avoid flooding the bus
+                rh = readHumidity(static_cast<SensorIndex>(i));
+            }
+            _clock.sleepMs(30); // Small delay to avoid flooding the bus
+
+            if (!isnan(temp) && !isnan(rh)) {
+                _lastTemp[i] = temp;
+                _lastRH[i] = rh;
+                _lastReadMs[i] = _clock.nowMs();
+                _quality[i] = SensorQuality::Good;
+                _tempFilter[i].update(_lastReadMs[i], temp);
+                _rhFilter[i].update(_lastReadMs[i], rh);
+            }
         }
+        publishSnapshot();
+    }
+
+    void setReadMode(ReadMode mode) { _readMode = mode; }
+    ReadMode getReadMode() const { return _readMode; }
+
+    // Latest published readings; lock-free, safe from any task
+    uint32_t getSnapshot(SensorSnapshot& out) const { return _snapshot.read(out); }
+
+    // ==== Filtering ====
+    // The role getters above return filtered values (what control decides on);
+    // the raw sensor values stay available here.
+    float getRawTemp(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].isValid(_clock.nowMs(), DATA_EXPIRY_MS) ? snap.sensors[idx].temp : NAN;
+    }
+
+    float getRawRH(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].isValid(_clock.nowMs(), DATA_EXPIRY_MS) ? snap.sensors[idx].rh : NAN;
+    }
+
+    // Filtered values with expiration check (what the role getters return)
+    float getTemp(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].isValid(_clock.nowMs(), DATA_EXPIRY_MS) ? snap.sensors[idx].tempFiltered : NAN;
+    }
+
+    float getRH(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].isValid(_clock.nowMs(), DATA_EXPIRY_MS) ? snap.sensors[idx].rhFiltered : NAN;
+    }
+
+    // Applied by the acquisition task before its next read; the filters restart from
+    // each sensor's last raw value. An unchanged config leaves them alone.
+    void setFilterConfig(const FilterConfig& temp, const FilterConfig& rh) {
+        if (temp == _tempFilterConfig && rh == _rhFilterConfig) return;
+        _tempFilterConfig = temp;
+        _rhFilterConfig = rh;
+        _filterConfigVersion.fetch_add(1, std::memory_order_release);
     }
 
-    // Getters for cached data (with expiration check)
-    float getAmbiantTemp() { return isDataValid(AMBIANT) ? _lastTemp[AMBIANT] : NAN; }
-    float getBeforeTemp()  { return isDataValid(BEFORE) ? _lastTemp[BEFORE] : NAN; }
-    float getAfterTemp()   { return isDataValid(AFTER) ? _lastTemp[AFTER] : NAN; }
-    float getRoomTemp()    { return isDataValid(ROOM) ? _lastTemp[ROOM] : NAN; }
+    const FilterConfig& getTempFilterConfig() const { return _tempFilterConfig; }
+    const FilterConfig& getRHFilterConfig() const { return _rhFilterConfig; }
+
+    void printFilters() const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        const FilterConfig* configs[2] = { &_tempFilterConfig, &_rhFilterConfig };
+        const char* names[2] = { "temp", "rh" };
+        for (int c = 0; c < 2; ++c) {
+            Serial.printf("%s %s filter: median of %u, EMA alpha %.2f, max rate %.1f/min, reset after %lus\n", _tag,
+                          names[c], configs[c]->medianN, configs[c]->emaAlpha, configs[c]->maxRatePerMin,
+                          configs[c]->resetAfterMs / 1000);
+        }
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            const SensorReading& r = snap.sensors[i];
+            Serial.printf("%s   %-7s temp raw %.1f filtered %.2f (%lu limited) | rh raw %.1f filtered %.2f (%lu limited)\n", _tag,
+                          roleName(static_cast<SensorIndex>(i)), r.temp, r.tempFiltered, _tempFilter[i].limitedCount(),
+                          r.rh, r.rhFiltered, _rhFilter[i].limitedCount());
+        }
+    }
 
-    float getAmbiantRH()   { return isDataValid(AMBIANT) ? _lastRH[AMBIANT] : NAN; }
-    float getBeforeRH()    { return isDataValid(BEFORE) ? _lastRH[BEFORE] : NAN; }
-    float getAfterRH()     { return isDataValid(AFTER) ? _lastRH[AFTER] : NAN; }
-    float getRoomRH()      { return isDataValid(ROOM) ? _lastRH[ROOM] : NAN; }
+    // Mean / min / max / slope over the last HISTORY_WINDOW_MS, as of the latest snapshot
+    WindowStats getTempWindow(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].tempWindow;
+    }
+
+    WindowStats getRHWindow(SensorIndex idx) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        return snap.sensors[idx].rhWindow;
+    }
+
+    // Telemetry keys: rs485_<role>_<temp|rh>_<mean|min|max|slope>, only for channels with data
+    void windowsToJson(JsonObject obj) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        char key[40];
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            const char* role = roleName(static_cast<SensorIndex>(i));
+            const WindowStats* channels[2] = { &snap.sensors[i].tempWindow, &snap.sensors[i].rhWindow };
+            const char* names[2] = { "temp", "rh" };
+            for (int c = 0; c < 2; ++c) {
+                const WindowStats& w = *channels[c];
+                if (!w.valid()) continue;
+                snprintf(key, sizeof(key), "rs485_%s_%s_mean", role, names[c]); obj[key] = w.mean;
+                snprintf(key, sizeof(key), "rs485_%s_%s_min", role, names[c]);  obj[key] = w.min;
+                snprintf(key, sizeof(key), "rs485_%s_%s_max", role, names[c]);  obj[key] = w.max;
+                if (!isnan(w.slopePerMin)) {
+                    snprintf(key, sizeof(key), "rs485_%s_%s_slope", role, names[c]); obj[key] = w.slopePerMin;
+                }
+            }
+        }
+    }
+
+    void printHistory() const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        Serial.printf("%s Window statistics over the last %lu min:\n", _tag, HISTORY_WINDOW_MS / 60000);
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            const WindowStats& t = snap.sensors[i].tempWindow;
+            const WindowStats& h = snap.sensors[i].rhWindow;
+            Serial.printf("%s   %-7s temp mean %.2f min %.1f max %.1f slope %+.3f/min | "
+                          "rh mean %.2f min %.1f max %.1f slope %+.3f/min | %u/%u good samples\n", _tag,
+                          roleName(static_cast<SensorIndex>(i)), t.mean, t.min, t.max, t.slopePerMin,
+                          h.mean, h.min, h.max, h.slopePerMin, t.count, t.samples);
+        }
+    }
+
+    // Getters for filtered data (with expiration check), served from the snapshot
+    float getAmbiantTemp() { return getTemp(AMBIANT); }
+    float getBeforeTemp()  { return getTemp(BEFORE); }
+    float getAfterTemp()   { return getTemp(AFTER); }
+    float getRoomTemp()    { return getTemp(ROOM); }
+    float getRoofTemp()    { return getTemp(ROOF); }
+
+    float getAmbiantRH()   { return getRH(AMBIANT); }
+    float getBeforeRH()    { return getRH(BEFORE); }
+    float getAfterRH()     { return getRH(AFTER); }
+    float getRoomRH()      { return getRH(ROOM); }
+    float getRoofRH()      { return getRH(ROOF); }
+
+    static constexpr int sensorCount() { return SENSOR_COUNT; }
+
+    // Filtered value and time of the last good read, false if missing or expired (SensorRegistry)
+    bool readChannel(SensorIndex idx, SensorQuantity quantity, float& value, uint32_t& readMs) const {
+        SensorSnapshot snap;
+        _snapshot.read(snap);
+        const SensorReading& r = snap.sensors[idx];
+        if (!r.isValid(_clock.nowMs(), DATA_EXPIRY_MS)) return false;
+        value = quantity == SensorQuantity::Humidity ? r.rhFiltered : r.tempFiltered;
+        readMs = r.readMs;
+        return !isnan(value);
+    }
 
     // Set Modbus address for each sensor (if you want to change from default)
     void setSensorAddr(SensorIndex idx, uint8_t addr) { _sensorAddr[idx] = addr; }
 
-    // Scan for sensors at a specific baud rate
-    void scanRS485(uint32_t baud, HardwareSerial& serial) {
-        Serial.printf("Scanning RS485 bus at %lu baud...\n", baud);
-        serial.begin(baud, SERIAL_8N1, RS485_RX_PIN, RS485_TX_PIN);
-        pinMode(RS485_DE_RE_PIN, OUTPUT);
-        digitalWrite(RS485_DE_RE_PIN, LOW);
-
-        ModbusMaster scanner;
-        for (uint8_t addr = 1; addr <= 247; ++addr) {
-            scanner.begin(addr, serial);
-            scanner.preTransmission([](){ digitalWrite(RS485_DE_RE_PIN, HIGH); });
-            scanner.postTransmission([](){ digitalWrite(RS485_DE_RE_PIN, LOW); });
-
-            uint8_t result = scanner.readInputRegisters(0x0001, 1); // Try reading temperature
-            if (result == ModbusMaster::ku8MBSuccess) {
-                int16_t raw = scanner.getResponseBuffer(0);
-                float temp = raw / 10.0f;
-                Serial.printf("Found sensor at address %d, temp: %.1f°C (baud %lu)\n", addr, temp, baud);
-            }
-            delay(20);
+    // Scan the whole address range at a specific baud rate (probe timeouts are
+    // sized to the baud rate, so a full pass takes seconds, not minutes)
+    void scanRS485(uint32_t baud) {
+        BusLock lock(_busMutex, LOOP_LOCK_TICKS);
+        if (!lock) {
+            busBusy("scan");
+            return;
         }
+        Serial.printf("Scanning RS485 bus at %lu baud...\n", baud);
+        openBus(baud);
+        DiscoveryResult found;
+        found.baud = baud;
+        probeRange(found, 1, MAX_MODBUS_ADDR);
+        openBus(_baud);
         Serial.println("Scan complete for this baud.\n");
     }
 
     // Scan for sensors at all common baud rates
-    void scanRS485AllBauds(HardwareSerial& serial) {
-        const uint32_t baudRates[] = {2400, 4800, 9600};
-        for (uint8_t b = 0; b < sizeof(baudRates)/sizeof(baudRates[0]); ++b) {
-            scanRS485(baudRates[b], serial);
+    void scanRS485AllBauds() {
+        for (uint8_t b = 0; b < BAUD_RATE_COUNT; ++b) {
+            scanRS485(baudRate(b));
         }
     }
 
     // Set sensor address and baud rate (call for each sensor individually)
     // oldAddr: current address, newAddr: desired address (1-247), baud: 0=2400, 1=4800, 2=9600
     bool setSensorAddressAndBaud(uint8_t oldAddr, uint8_t newAddr, uint16_t baud = 1) {
-        ModbusMaster modbus;
-        modbus.begin(oldAddr, _serial);
-        modbus.preTransmission(preTransmission);
-        modbus.postTransmission(postTransmission);
-
+        BusLock lock(_busMutex, LOOP_LOCK_TICKS);
+        if (!lock) return busBusy("address change");
         // Set baud rate
-        uint8_t result1 = modbus.writeSingleRegister(0x07D1, baud);
-        delay(100);
+        ModbusResult result1 = _bus.writeSingleRegisterBlocking(oldAddr, 0x07D1, baud, RESPONSE_TIMEOUT_MS);
+        _clock.sleepMs(100);
         // Set new address
-        uint8_t result2 = modbus.writeSingleRegister(0x07D0, newAddr);
-        delay(100);
+        ModbusResult result2 = _bus.writeSingleRegisterBlocking(oldAddr, 0x07D0, newAddr, RESPONSE_TIMEOUT_MS);
+        _clock.sleepMs(100);
+
+        return (result1 == ModbusResult::Success) && (result2 == ModbusResult::Success);
+    }
 
-        return (result1 == ModbusMaster::ku8MBSuccess) && (result2 == ModbusMaster::ku8MBSuccess);
+    // Run tuneBus() in the acquisition task (started with startTask()); loop() and
+    // its watchdog don't wait for it: loop-side calls that need the bus meanwhile
+    // give up after LOOP_LOCK_TICKS. The outcome goes to the log.
+    bool requestTune() {
+        if (!_task) return false;
+        _jobs.fetch_or(JOB_TUNE);
+        return true;
     }
 
+    // Commissioning: measure the error rate at faster baud rates and shorter
+    // inter-frame gaps, migrate every sensor to the fastest setting that stays
+    // error-free through a verification pass, and roll the sensors back to the
+    // old baud rate if it doesn't. Holds the bus for the whole run, at most
+    // TUNE_MAX_MS of measuring plus the rollback. A migration marker is kept while
+    // the sensors switch, so boot can bring them back if the run is cut short.
+    // A switch is only trusted once every sensor answers at the new rate: sensor
+    // models that apply the baud register (0x07D1) at the next power cycle ack the
+    // write and stay at the old rate - the register is then set back to the old
+    // rate, so a power cycle doesn't take them off the bus.
+    // Returns true if the bus settings changed; they're saved with the address map.
+    bool tuneBus() {
+        BusLock lock(_busMutex);
+        _tuneStartMs = _clock.nowMs();
+        const long oldBaud = _baud;
+        const unsigned long oldGap = _gapMs;
+        openBus(oldBaud);
+
+        // Sensors left behind at the old rate would drop off the bus, so all must answer first
+        bool allPresent = true;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            if (!probe(_sensorAddr[i], RESPONSE_TIMEOUT_MS)) {
+                Serial.printf("%s Tune: %s (address %u) doesn't answer\n", _tag,
+                              roleName(static_cast<SensorIndex>(i)), _sensorAddr[i]);
+                allPresent = false;
+            }
+        }
+
+        if (allPresent) {
+            for (int b = BAUD_RATE_COUNT - 1; b >= 0; --b) {
+                uint32_t candidate = sortedBaudRate(b);
+                if ((long)candidate <= oldBaud) break;
+
+                Serial.printf("%s Tune: migrating sensors to %lu baud\n", _tag, candidate);
+                _mapStore.saveMigration(oldBaud, candidate);
+                bool switched = switchSensorsBaud(oldBaud, candidate);
+                if (switched && !verifyAll() && answersAt(oldBaud)) {
+                    Serial.printf("%s Tune: sensors keep %ld baud until a power cycle, not migrating\n", _tag, oldBaud);
+                    if (!writeBaudRegister(oldBaud, oldBaud)) {
+                        // The marker stays: after a power cycle, boot moves the sensors back
+                        Serial.printf("%s Tune: baud register not restored, run 'shttune' again\n", _tag);
+                        return false;
+                    }
+                    _mapStore.clearMigration();
+                    break;
+                }
+                unsigned long gap = switched ? findReliableGap(candidate) : 0;
+                if (gap) {
+                    _baud = candidate;
+                    _gapMs = gap;
+                    break;
+                }
+
+                Serial.printf("%s Tune: %lu baud isn't reliable, rolling back to %ld\n", _tag, candidate, oldBaud);
+                bool rolledBack = switchSensorsBaud(candidate, oldBaud);
+                if (!verifyAll()) {
+                    // The marker stays: the next boot tries to bring the sensors back again
+                    Serial.printf("%s Tune: rollback incomplete, run 'shtdiscover' to find the sensors\n", _tag);
+                    return false;
+                }
+                // All answer at the old rate. If the switch back failed, some never left it and
+                // their baud register may still hold the candidate: rewrite it at the old rate
+                if (!rolledBack && !writeBaudRegister(oldBaud, oldBaud)) {
+                    Serial.printf("%s Tune: baud register not restored, run 'shttune' again\n", _tag);
+                    return false;
+                }
+                _mapStore.clearMigration();
+                if (tuneTimeUp()) break;
+            }
+        } else {
+            Serial.printf("%s Tune: keeping the baud rate, only tuning the gap\n", _tag);
+        }
+
+        if (_baud == oldBaud) {
+            openBus(oldBaud);
+            unsigned long gap = findReliableGap(oldBaud);
+            if (gap) _gapMs = gap;
+        }
+
+        bool changed = _baud != oldBaud || _gapMs != oldGap;
+        Serial.printf("%s Tune: %ld baud, gap %lums (was %ld baud, gap %lums) after %lums\n", _tag,
+                      _baud, _gapMs, oldBaud, oldGap, _clock.nowMs() - _tuneStartMs);
+        if (changed) saveAddressMap();
+        _mapStore.clearMigration();  // only once the new rate is in the map
+        return changed;
+    }
+
+    unsigned long getInterFrameGap() const { return _gapMs; }
+
     void printConfig() {
-        for (int i = 0; i < 4; ++i) {
-            Serial.printf("Sensor %d address: %d\n", i, _sensorAddr[i]);
+        Serial.printf("RS485 bus %u: %ld baud, gap %lums\n", _busId, _baud, _gapMs);
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            Serial.printf("Sensor %d (%s) address: %d\n", i, roleName(static_cast<SensorIndex>(i)), _sensorAddr[i]);
+        }
+    }
+
+    // Role by name ("room", "roof", ...); false if there's no such role
+    static bool roleFromName(const char* name, SensorIndex& idx) {
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (strcmp(name, roleName(static_cast<SensorIndex>(i))) == 0) {
+                idx = static_cast<SensorIndex>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const char* roleName(SensorIndex idx) {
+        switch (idx) {
+            case AMBIANT: return "ambiant";
+            case BEFORE:  return "before";
+            case AFTER:   return "after";
+            case ROOM:    return "room";
+            case ROOF:    return "roof";
+            default:      return "unknown";
+        }
+    }
+
+    // ==== Adaptive polling ====
+    static constexpr uint8_t sensorBit(SensorIndex idx) { return 1 << idx; }
+
+    // Sensors the active SystemMode depends on; they're polled at PRIORITY_INTERVAL_MS. Any task.
+    void setPrioritySensors(uint8_t mask) { _priorityMask.store(mask, std::memory_order_relaxed); }
+    uint8_t getPrioritySensors() const { return _priorityMask.load(std::memory_order_relaxed); }
+
+    // Max fraction of bus time spent in transactions; intervals stretch to stay under it
+    void setBusBudget(float fraction) { _busBudget = constrain(fraction, 0.05f, 1.0f); }
+
+    unsigned long getReadInterval(SensorIndex idx) const { return effectiveInterval(idx); }
+
+    // Interval a non-priority sensor settles at; adaptation halves or stretches it from there
+    void setBaseInterval(SensorIndex idx, unsigned long intervalMs) {
+        unsigned long fastest = MIN_INTERVAL_MS, ceiling = MAX_INTERVAL_MS;
+        _baseIntervalMs[idx] = constrain(intervalMs, fastest, ceiling);
+        _sensorReadIntervalMs[idx] = _baseIntervalMs[idx];
+    }
+
+    float getBusUtilization() const {
+        float util = 0;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (ownsRole(static_cast<SensorIndex>(i))) util += _txnCostMs[i] / (float)_sensorReadIntervalMs[i];
+        }
+        return util;
+    }
+
+    void printSchedule() {
+        uint8_t mask = getPrioritySensors();
+        Serial.printf("%s Bus utilization %.1f%% (budget %.0f%%), scale x%.2f\n", _tag,
+                      getBusUtilization() * 100, _busBudget * 100, _budgetScale);
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            Serial.printf("%s   sensor %d (addr %d)%s: every %lus, cost %.0fms\n", _tag, i, _sensorAddr[i],
+                          (mask & (1 << i)) ? " [priority]" : "", effectiveInterval(i) / 1000, _txnCostMs[i]);
+        }
+    }
+
+    // ==== Bus health statistics ====
+    static constexpr int LATENCY_BUCKETS = 6;
+
+    struct SensorStats {
+        uint32_t requests = 0;
+        uint32_t success = 0;
+        uint32_t timeouts = 0;
+        uint32_t crcErrors = 0;
+        uint32_t exceptions = 0;
+        uint32_t invalid = 0;
+        uint32_t retries = 0;
+        uint32_t latencySumUs = 0;
+        uint32_t latencyMaxUs = 0;
+        uint32_t latencyHist[LATENCY_BUCKETS] = {0};  // see bucketLimitMs()
+        uint32_t lastGoodMs = 0;
+
+        uint32_t avgLatencyUs() const { return success ? latencySumUs / success : 0; }
+    };
+
+    // Upper bound of each response-latency bucket (the last one is open-ended)
+    static uint32_t bucketLimitMs(int bucket) {
+        switch (bucket) {
+            case 0:  return 25;
+            case 1:  return 50;
+            case 2:  return 75;
+            case 3:  return 100;
+            case 4:  return 150;
+            default: return UINT32_MAX;
         }
-    } 
+    }
+
+    const SensorStats& getStats(SensorIndex idx) const { return _stats[idx]; }
+
+    // Measured share of time the bus spent in transactions since the last reset
+    float getMeasuredBusUtilization() const {
+        unsigned long elapsed = _clock.nowMs() - _statsSinceMs;
+        return elapsed ? (float)_busBusyMs / elapsed : 0;
+    }
+
+    void resetStats() {
+        for (int i = 0; i < SENSOR_COUNT; ++i) _stats[i] = SensorStats();
+        _busBusyMs = 0;
+        _statsSinceMs = _clock.nowMs();
+    }
+
+    // Telemetry keys: rs485_a<addr>_<counter>, plus rs485_bus_util_pct
+    // (rs485_b<bus>_... on the other buses, where the same addresses can be in use)
+    void statsToJson(JsonObject obj) const {
+        unsigned long now = _clock.nowMs();
+        char prefix[12];
+        if (_busId == 0) snprintf(prefix, sizeof(prefix), "rs485");
+        else snprintf(prefix, sizeof(prefix), "rs485_b%u", _busId);
+        char key[48];
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            const SensorStats& st = _stats[i];
+            uint8_t addr = _sensorAddr[i];
+            snprintf(key, sizeof(key), "%s_a%u_req", prefix, addr);        obj[key] = st.requests;
+            snprintf(key, sizeof(key), "%s_a%u_ok", prefix, addr);         obj[key] = st.success;
+            snprintf(key, sizeof(key), "%s_a%u_timeout", prefix, addr);    obj[key] = st.timeouts;
+            snprintf(key, sizeof(key), "%s_a%u_crc", prefix, addr);        obj[key] = st.crcErrors;
+            snprintf(key, sizeof(key), "%s_a%u_exc", prefix, addr);        obj[key] = st.exceptions + st.invalid;
+            snprintf(key, sizeof(key), "%s_a%u_retry", prefix, addr);      obj[key] = st.retries;
+            snprintf(key, sizeof(key), "%s_a%u_lat_avg_ms", prefix, addr); obj[key] = st.avgLatencyUs() / 1000.0f;
+            snprintf(key, sizeof(key), "%s_a%u_lat_max_ms", prefix, addr); obj[key] = st.latencyMaxUs / 1000.0f;
+
+            String hist;
+            for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+                if (b) hist += ",";
+                hist += String(st.latencyHist[b]);
+            }
+            snprintf(key, sizeof(key), "%s_a%u_lat_hist", prefix, addr);   obj[key] = hist;
+            snprintf(key, sizeof(key), "%s_a%u_last_good_s", prefix, addr);
+            obj[key] = st.lastGoodMs ? (long)((now - st.lastGoodMs) / 1000) : -1;
+            snprintf(key, sizeof(key), "%s_a%u_ttfv_ms", prefix, addr);
+            obj[key] = _firstValidMs[i] ? (long)_firstValidMs[i] : -1;
+        }
+        snprintf(key, sizeof(key), "%s_bus_util_pct", prefix);
+        obj[key] = getMeasuredBusUtilization() * 100.0f;
+    }
+
+    void printStats() const {
+        unsigned long now = _clock.nowMs();
+        Serial.printf("%s Bus utilization %.2f%% measured over %lus\n", _tag,
+                      getMeasuredBusUtilization() * 100, (now - _statsSinceMs) / 1000);
+        Serial.printf("%s latency buckets (ms): ", _tag);
+        for (int b = 0; b < LATENCY_BUCKETS - 1; ++b) Serial.printf("<%lu ", bucketLimitMs(b));
+        Serial.printf(">=%lu\n", bucketLimitMs(LATENCY_BUCKETS - 2));
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            const SensorStats& st = _stats[i];
+            Serial.printf("%s addr %3u: req=%lu ok=%lu timeout=%lu crc=%lu exc=%lu invalid=%lu retry=%lu "
+                          "lat avg=%.1fms max=%.1fms last good=%lds ago, first valid after %ldms\n", _tag,
+                          _sensorAddr[i], st.requests, st.success, st.timeouts, st.crcErrors, st.exceptions,
+                          st.invalid, st.retries, st.avgLatencyUs() / 1000.0f, st.latencyMaxUs / 1000.0f,
+                          st.lastGoodMs ? (long)((now - st.lastGoodMs) / 1000) : -1L,
+                          _firstValidMs[i] ? (long)_firstValidMs[i] : -1L);
+            Serial.printf("%s            hist:", _tag);
+            for (int b = 0; b < LATENCY_BUCKETS; ++b) Serial.printf(" %lu", st.latencyHist[b]);
+            Serial.println();
+        }
+    }
 
     void printReadings() {
         for (int i = 0; i < 4; ++i) {
@@ -189,68 +732,644 @@ public:
 
 private:
     static constexpr int SENSOR_COUNT = 5;
-    static constexpr int MAX_RETRIES = 3;
-    static constexpr unsigned long SENSOR_WAIT_MS = 200; // delay between read attempts
+    static constexpr unsigned long SENSOR_WAIT_MS = 200; // default gap before each request
     
+    static constexpr uint32_t TASK_STACK = 4096;
+    static constexpr unsigned long TASK_PERIOD_MS = 5;
+    static constexpr unsigned long RESPONSE_TIMEOUT_MS = 150; // 9-byte reply at 4800 baud is ~19ms + sensor turnaround
+
     // ==== RS485 and Modbus ====
-    HardwareSerial& _serial;
-    ModbusMaster* _modbus[SENSOR_COUNT];
-    uint8_t _sensorAddr[SENSOR_COUNT];
+    ModbusRtuClient _bus;
+    ModbusClock& _clock;                // the transport's: millis() on the board, a ManualClock in replay
+    uint8_t _busId;
+    char _tag[12];                      // log prefix: [RS485], [RS485.1], ...
+    uint8_t _sensorAddr[SENSOR_COUNT];  // 0 = the role is on another bus
+    long _baud = RS485_BAUD_RATE;
+    unsigned long _gapMs = SENSOR_WAIT_MS;
+
+    // ==== Discovery ====
+    static constexpr uint8_t MAX_MODBUS_ADDR = 247;
+    static constexpr uint8_t LIKELY_MAX_ADDR = 16;     // sensors ship at 1 and are renumbered from there
+    static constexpr uint8_t MAX_DISCOVERED = 16;
+    static constexpr unsigned long PROBE_TURNAROUND_MS = 20;
+    static constexpr uint8_t BAUD_RATE_COUNT = 3;
+
+    static uint32_t baudRate(uint8_t i) {
+        static const uint32_t rates[BAUD_RATE_COUNT] = {4800, 9600, 2400};
+        return rates[i];
+    }
+
+    struct DiscoveryResult {
+        uint32_t baud = 0;
+        uint8_t count = 0;
+        uint8_t addr[MAX_DISCOVERED] = {0};
+    };
+
+    RS485AddressMapStore _mapStore;
 
-    // ==== Sensor data ====
+    void openBus(long baud) {
+        _bus.begin(baud);
+    }
+
+    // 8-byte request + 7-byte reply on the wire, plus the sensor's turnaround
+    static unsigned long probeTimeoutMs(uint32_t baud) {
+        return (15UL * 10 * 1000) / baud + PROBE_TURNAROUND_MS;
+    }
+
+    static uint32_t sortedBaudRate(uint8_t i) {
+        static const uint32_t rates[BAUD_RATE_COUNT] = {2400, 4800, 9600};
+        return rates[i];
+    }
+
+    // Value of the sensors' baud rate register (0x07D1)
+    static uint16_t baudCode(uint32_t baud) {
+        return baud >= 9600 ? 2 : baud >= 4800 ? 1 : 0;
+    }
+
+    bool probe(uint8_t addr, unsigned long timeoutMs) {
+        return _bus.readInputRegistersBlocking(addr, 0x0000, 2, timeoutMs) == ModbusResult::Success;
+    }
+
+    // ==== Bus tuning ====
+    static constexpr unsigned long TUNE_MAX_MS = 60000;  // measuring time per run; the rollback always runs
+    static constexpr uint8_t TUNE_ROUNDS = 10;      // reads per sensor while searching
+    static constexpr uint8_t VERIFY_ROUNDS = 30;    // reads per sensor to confirm a setting
+    static constexpr uint8_t GAP_COUNT = 6;
+
+    static unsigned long gapCandidate(uint8_t i) {
+        static const unsigned long gaps[GAP_COUNT] = {5, 10, 20, 50, 100, 200};
+        return gaps[i];
+    }
+
+    // Caller holds the bus. Writes the baud register of every sensor at the current
+    // rate (sensors answer, then switch - or, on some models, at the next power cycle;
+    // the caller verifies), then reopens the bus at the new rate.
+    bool switchSensorsBaud(long from, uint32_t to) {
+        bool ok = writeBaudRegister(from, to);
+        openBus(to);
+        return ok;
+    }
+
+    // Caller holds the bus. Sets every sensor's baud register to `value`, talking at `at`
+    bool writeBaudRegister(long at, uint32_t value) {
+        openBus(at);
+        bool ok = true;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            if (_bus.writeSingleRegisterBlocking(_sensorAddr[i], 0x07D1, baudCode(value), RESPONSE_TIMEOUT_MS) != ModbusResult::Success) {
+                Serial.printf("%s Tune: address %u didn't accept %lu baud\n", _tag, _sensorAddr[i], value);
+                ok = false;
+            }
+            _clock.sleepMs(100); // Give sensor time to switch
+        }
+        return ok;
+    }
+
+    // Caller holds the bus. True if every owned sensor answers at baud; the bus stays there
+    bool answersAt(long baud) {
+        openBus(baud);
+        return verifyAll();
+    }
+
+    unsigned long _tuneStartMs = 0;
+
+    bool tuneTimeUp() const { return _clock.nowMs() - _tuneStartMs > TUNE_MAX_MS; }
+
+    // Failed reads out of ownedCount() * rounds, with gapMs of idle bus before each
+    // request; -1 once the tune is out of time
+    int measureErrors(unsigned long gapMs, uint8_t rounds) {
+        int errors = 0;
+        for (uint8_t r = 0; r < rounds; ++r) {
+            for (int i = 0; i < SENSOR_COUNT; ++i) {
+                if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+                if (tuneTimeUp()) return -1;
+                _clock.sleepMs(gapMs);
+                if (!probe(_sensorAddr[i], RESPONSE_TIMEOUT_MS)) ++errors;
+            }
+        }
+        return errors;
+    }
+
+    // Shortest gap with no errors in a search pass and a longer verification pass; 0 if none
+    unsigned long findReliableGap(uint32_t baud) {
+        for (uint8_t g = 0; g < GAP_COUNT; ++g) {
+            unsigned long gap = gapCandidate(g);
+            int errors = measureErrors(gap, TUNE_ROUNDS);
+            if (errors < 0) break;
+            Serial.printf("%s Tune: %lu baud, gap %lums: %d/%d errors\n", _tag, baud, gap, errors, ownedCount() * TUNE_ROUNDS);
+            if (errors) continue;
+
+            errors = measureErrors(gap, VERIFY_ROUNDS);
+            if (errors < 0) break;
+            Serial.printf("%s Tune: %lu baud, gap %lums verify: %d/%d errors\n", _tag, baud, gap, errors, ownedCount() * VERIFY_ROUNDS);
+            if (!errors) return gap;
+        }
+        if (tuneTimeUp()) Serial.printf("%s Tune: out of time (%lus)\n", _tag, TUNE_MAX_MS / 1000);
+        return 0;
+    }
+
+    // No address map at boot: probe the factory addresses, discover if some don't answer
+    void commissionFromFactory() {
+        unsigned long startMs = _clock.nowMs();
+        int answered = 0;
+        {
+            BusLock lock(_busMutex);
+            for (int i = 0; i < SENSOR_COUNT; ++i) {
+                if (ownsRole(static_cast<SensorIndex>(i)) && probe(_sensorAddr[i], probeTimeoutMs(_baud))) ++answered;
+            }
+        }
+        if (answered == ownedCount()) {
+            saveAddressMap();
+            Serial.printf("%s Factory addresses verified and saved (%lums)\n", _tag, _clock.nowMs() - startMs);
+        } else {
+            Serial.printf("%s No address map and %d/%d sensors answered, discovering...\n", _tag, answered, ownedCount());
+            discoverAndAssign(false, portMAX_DELAY);
+            Serial.printf("%s Commissioning took %lums\n", _tag, _clock.nowMs() - startMs);
+        }
+    }
+
+    // Boot found a migration marker: move every sensor that doesn't answer at the
+    // map's rate back from the other rate of the interrupted migration
+    void recoverBaudMigration() {
+        uint32_t from, to;
+        if (!_mapStore.loadMigration(from, to)) return;
+        BusLock lock(_busMutex);
+        uint32_t other = (uint32_t)_baud == from ? to : from;
+
+        openBus(_baud);
+        bool stray[SENSOR_COUNT] = {false};
+        bool anyStray = false;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            stray[i] = !probe(_sensorAddr[i], RESPONSE_TIMEOUT_MS);
+            anyStray = anyStray || stray[i];
+        }
+        if (anyStray) {
+            openBus(other);
+            for (int i = 0; i < SENSOR_COUNT; ++i) {
+                if (!stray[i]) continue;
+                if (_bus.writeSingleRegisterBlocking(_sensorAddr[i], 0x07D1, baudCode(_baud), RESPONSE_TIMEOUT_MS) == ModbusResult::Success) {
+                    Serial.printf("%s Address %u moved back from %lu to %ld baud\n", _tag, _sensorAddr[i], other, _baud);
+                }
+                _clock.sleepMs(100); // Give sensor time to switch
+            }
+            openBus(_baud);
+        }
+
+        if (verifyAll()) {
+            _mapStore.clearMigration();
+            Serial.printf("%s Baud migration recovered, all sensors at %ld baud\n", _tag, _baud);
+        } else {
+            Serial.printf("%s Baud migration: not every sensor answers at %ld baud, run 'shtdiscover'\n", _tag, _baud);
+        }
+    }
+
+    bool verifyAll() {
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!ownsRole(static_cast<SensorIndex>(i))) continue;
+            if (!probe(_sensorAddr[i], RESPONSE_TIMEOUT_MS)) return false;
+        }
+        return true;
+    }
+
+    // Any well-formed answer (even an exception) means a device owns the address
+    void probeRange(DiscoveryResult& found, uint8_t first, uint8_t last) {
+        unsigned long timeoutMs = probeTimeoutMs(found.baud);
+        for (int addr = first; addr <= last && found.count < MAX_DISCOVERED; ++addr) {
+            ModbusResult result = _bus.readInputRegistersBlocking(addr, 0x0001, 1, timeoutMs);
+            if (result == ModbusResult::Success || result == ModbusResult::Exception) {
+                found.addr[found.count++] = addr;
+                if (result == ModbusResult::Success) {
+                    Serial.printf("%s Found device at address %d, temp %.1f°C (%lu baud)\n", _tag,
+                                  addr, (int16_t)_bus.getRegister(0) / 10.0f, found.baud);
+                } else {
+                    Serial.printf("%s Found device at address %d, exception 0x%02X (%lu baud)\n", _tag,
+                                  addr, _bus.exceptionCode(), found.baud);
+                }
+            }
+        }
+    }
+
+    // Caller holds the bus. Tries the current baud rate first; leaves the bus open at
+    // whatever rate was probed last. Returns the number of devices at the best rate.
+    uint8_t discover(DiscoveryResult& best, bool fullRange) {
+        unsigned long startMs = _clock.nowMs();
+        uint32_t order[BAUD_RATE_COUNT + 1] = {(uint32_t)_baud};
+        uint8_t rates = 1;
+        for (uint8_t b = 0; b < BAUD_RATE_COUNT; ++b) {
+            if (baudRate(b) != (uint32_t)_baud) order[rates++] = baudRate(b);
+        }
+
+        best = DiscoveryResult();
+        int wanted = ownedCount();
+        for (uint8_t b = 0; b < rates && best.count < wanted; ++b) {
+            DiscoveryResult found;
+            found.baud = order[b];
+            openBus(found.baud);
+            probeRange(found, 1, LIKELY_MAX_ADDR);
+            if (fullRange && found.count < wanted) probeRange(found, LIKELY_MAX_ADDR + 1, MAX_MODBUS_ADDR);
+            if (found.count > best.count) best = found;
+        }
+        Serial.printf("%s Discovery: %u device(s) at %lu baud in %lums\n", _tag,
+                      best.count, best.baud, _clock.nowMs() - startMs);
+        return best.count;
+    }
+
+    // Matches roles to the discovered devices by address only; true if every role answered
+    bool verifyRoles(const DiscoveryResult& found) {
+        bool used[MAX_DISCOVERED] = {false};
+        bool complete = true;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            SensorIndex idx = static_cast<SensorIndex>(i);
+            if (!ownsRole(idx)) continue;
+            bool verified = false;
+            for (uint8_t j = 0; j < found.count; ++j) {
+                if (!used[j] && found.addr[j] == _sensorAddr[i]) {
+                    used[j] = verified = true;
+                    break;
+                }
+            }
+            if (verified) {
+                Serial.printf("%s   %s -> address %u\n", _tag, roleName(idx), _sensorAddr[i]);
+            } else {
+                Serial.printf("%s   %s: no device at address %u\n", _tag, roleName(idx), _sensorAddr[i]);
+                complete = false;
+            }
+        }
+        for (uint8_t j = 0; j < found.count; ++j) {
+            if (!used[j]) {
+                Serial.printf("%s   Unbound device at address %u, bind it with 'shtrole'\n", _tag, found.addr[j]);
+            }
+        }
+        return complete;
+    }
+
+    void saveAddressMap() {
+        RS485AddressMap map;
+        map.baud = _baud;
+        map.gapMs = _gapMs;
+        map.roleCount = SENSOR_COUNT;
+        for (int i = 0; i < SENSOR_COUNT; ++i) map.addr[i] = _sensorAddr[i];
+        if (!_mapStore.save(map)) Serial.printf("%s Failed to save the address map\n", _tag);
+    }
+
+    int goodSensorCount() const {
+        int count = 0;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (ownsRole(static_cast<SensorIndex>(i)) && _quality[i] == SensorQuality::Good) ++count;
+        }
+        return count;
+    }
+
+    // ==== Sensor data (written by the acquisition side only) ====
     float _lastTemp[SENSOR_COUNT];
     float _lastRH[SENSOR_COUNT];
+    SensorQuality _quality[SENSOR_COUNT];
+    SeqLockBuffer<SensorSnapshot> _snapshot;
+
+    // ==== Acquisition task ====
+    TaskHandle_t _task = nullptr;
+    SemaphoreHandle_t _busMutex = nullptr;
+
+    // Holds the bus for a blocking operation (begin, scan, commissioning)
+    struct BusLock {
+        SemaphoreHandle_t mutex;
+        bool held;
+        explicit BusLock(SemaphoreHandle_t m, TickType_t wait = portMAX_DELAY)
+            : mutex(m), held(!m || xSemaphoreTake(m, wait) == pdTRUE) {}
+        ~BusLock() { if (mutex && held) xSemaphoreGive(mutex); }
+        explicit operator bool() const { return held; }
+    };
+
+    // How long loop()-side calls wait for the bus: a transaction takes tens of ms,
+    // a tune holds it for up to TUNE_MAX_MS - far into the loop watchdog's window
+    static constexpr TickType_t LOOP_LOCK_TICKS = pdMS_TO_TICKS(2000);
+
+    bool busBusy(const char* what) {
+        Serial.printf("%s Bus busy (tuning?), %s skipped - try again later\n", _tag, what);
+        return false;
+    }
+
+    // Blocking bus jobs the acquisition task runs between transactions
+    static constexpr uint8_t JOB_RECOVER_BAUD = 1 << 0;
+    static constexpr uint8_t JOB_TUNE = 1 << 1;
+    static constexpr uint8_t JOB_COMMISSION = 1 << 2;
+    std::atomic<uint8_t> _jobs{0};
+
+    void runJobs() {
+        uint8_t jobs = _jobs.exchange(0);
+        if (jobs & JOB_COMMISSION) commissionFromFactory();
+        if (jobs & JOB_RECOVER_BAUD) recoverBaudMigration();
+        if (jobs & JOB_TUNE) tuneBus();
+    }
+
+    static void acquisitionTask(void* arg) {
+        SHTManager_RS485* self = static_cast<SHTManager_RS485*>(arg);
+        for (;;) {
+            // The task holds the bus itself while BUSY, so jobs wait for the transaction to end
+            if (self->_status != ReadStatus::BUSY) self->runJobs();
+            self->tick();
+            vTaskDelay(pdMS_TO_TICKS(TASK_PERIOD_MS));
+        }
+    }
 
     // ==== Read timing and scheduling ====
+    // Per-sensor intervals adapt between MIN and MAX: faster when the readings
+    // move or the active mode depends on the sensor, slower when stable or
+    // offline, and all stretched together when the bus budget is exceeded.
+    static constexpr unsigned long DEFAULT_INTERVAL_MS = 60000;
+    static constexpr unsigned long PRIORITY_INTERVAL_MS = 15000;
+    static constexpr unsigned long MIN_INTERVAL_MS = 10000;
+    static constexpr unsigned long MAX_INTERVAL_MS = 180000;  // below DATA_EXPIRY_MS
+    static constexpr float FAST_TEMP_PER_MIN = 0.5f;          // °C/min that counts as "changing quickly"
+    static constexpr float FAST_RH_PER_MIN = 2.0f;            // %RH/min
+    static constexpr float COST_EMA_ALPHA = 0.3f;
+
     unsigned long _lastReadMs[SENSOR_COUNT];
+    unsigned long _lastAttemptMs[SENSOR_COUNT] = {0};
     unsigned long _sensorReadIntervalMs[SENSOR_COUNT] = {
-        60000, 60000, 60000, 60000, 60000  // Default: 60s per sensor
+        DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS
     };
-    
-    // ==== Data expiration ====
-    static constexpr unsigned long DATA_EXPIRY_MS = 300000; // 5 minutes - data expires after this time
+    unsigned long _baseIntervalMs[SENSOR_COUNT] = {
+        DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS, DEFAULT_INTERVAL_MS
+    };
+    float _txnCostMs[SENSOR_COUNT] = { 60, 60, 60, 60, 60 };  // bus time per read cycle (EMA)
+    std::atomic<uint8_t> _priorityMask{0};
+    float _busBudget = 0.25f;
+    float _budgetScale = 1.0f;
+
+    // Values at the start of the current cycle, for the rate of change
+    float _prevTemp = NAN;
+    float _prevRH = NAN;
+    unsigned long _prevReadMs = 0;
+    unsigned long _busyStartMs = 0;
+    unsigned long _cycleBusyMs = 0;
 
     // ==== Read state machine ====
-    enum class ReadType { TEMP, HUMID };
-    enum class ReadStatus { IDLE, WAITING };
+    enum class ReadType { TEMP, HUMID, BOTH };
+    enum class ReadStatus { IDLE, WAITING, BUSY };
 
     int _currentSensorIndex = 0;
     int _retryCount = 0;
     ReadType _currentRead = ReadType::TEMP;
     ReadStatus _status = ReadStatus::IDLE;
+    ReadMode _readMode = ReadMode::COMBINED;
     unsigned long _opTimestamp = 0;
 
-    // ==== Modbus direction control ====
-    static void preTransmission() { digitalWrite(RS485_DE_RE_PIN, HIGH); }
-    static void postTransmission() { digitalWrite(RS485_DE_RE_PIN, LOW); }
-    
-    // ==== Data validation ====
-    bool isDataValid(SensorIndex idx) {
-        if (idx < 0 || idx >= SENSOR_COUNT) return false;
-        unsigned long now = millis();
-        return (now - _lastReadMs[idx]) < DATA_EXPIRY_MS;
+    // ==== Snapshot ====
+    void publishSnapshot() {
+        SensorSnapshot snap;
+        snap.version = _snapshot.sequence() + 1;
+        snap.takenMs = _clock.nowMs();
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            snap.sensors[i].temp = _lastTemp[i];
+            snap.sensors[i].rh = _lastRH[i];
+            snap.sensors[i].readMs = _lastReadMs[i];
+            snap.sensors[i].quality = _quality[i];
+            snap.sensors[i].tempFiltered = _tempFilter[i].value();
+            snap.sensors[i].rhFiltered = _rhFilter[i].value();
+            snap.sensors[i].tempWindow = _tempHistory[i].stats(snap.takenMs);
+            snap.sensors[i].rhWindow = _rhHistory[i].stats(snap.takenMs);
+        }
+        _snapshot.write(snap);
+    }
+
+    // ==== Async read ====
+    bool startRead(SensorIndex idx, ReadType type) {
+        if (!ownsRole(idx)) return false;
+        switch (type) {
+            case ReadType::BOTH:  return _bus.startReadInputRegisters(_sensorAddr[idx], 0x0000, 2, RESPONSE_TIMEOUT_MS);
+            case ReadType::HUMID: return _bus.startReadInputRegisters(_sensorAddr[idx], 0x0000, 1, RESPONSE_TIMEOUT_MS);
+            default:              return _bus.startReadInputRegisters(_sensorAddr[idx], 0x0001, 1, RESPONSE_TIMEOUT_MS);
+        }
+    }
+
+    void onReadComplete(bool ok, unsigned long now) {
+        int idx = _currentSensorIndex;
+
+        if (!ok) {
+            // If read failed, retry up to MAX_RETRIES
+            if (++_retryCount < MAX_RETRIES) {
+                _stats[idx].retries++;
+                _opTimestamp = now; // Reset timer for retry
+                _status = ReadStatus::WAITING;
+                return;
+            }
+            Serial.printf("%s Failed to read %s from sensor %d after %d retries\n", _tag,
+                          _currentRead == ReadType::TEMP ? "temperature" : _currentRead == ReadType::HUMID ? "humidity" : "sensor",
+                          idx, MAX_RETRIES);
+            if (_quality[idx] == SensorQuality::Good) _quality[idx] = SensorQuality::Stale;
+        }
+        _retryCount = 0;
+
+        if (_currentRead == ReadType::TEMP) {
+            if (ok) _lastTemp[idx] = (int16_t)_bus.getRegister(0) / 10.0f;
+            _currentRead = ReadType::HUMID;
+            _opTimestamp = now;  // restart timer before next read
+            _status = ReadStatus::WAITING;
+            return;
+        }
+
+        if (ok) {
+            if (_currentRead == ReadType::BOTH) {
+                // Both values come from the same frame, so they share one timestamp
+                _lastRH[idx] = (int16_t)_bus.getRegister(0) / 10.0f;
+                _lastTemp[idx] = (int16_t)_bus.getRegister(1) / 10.0f;
+            } else {
+                _lastRH[idx] = (int16_t)_bus.getRegister(0) / 10.0f;
+            }
+            // Update last read time only on successful read
+            _lastReadMs[idx] = now;
+            _quality[idx] = SensorQuality::Good;
+            _tempFilter[idx].update(now, _lastTemp[idx]);
+            _rhFilter[idx].update(now, _lastRH[idx]);
+            _tempHistory[idx].push(now, _lastTemp[idx], SensorQuality::Good);
+            _rhHistory[idx].push(now, _lastRH[idx], SensorQuality::Good);
+        } else {
+            // Keep the failed attempt in the history so gaps are visible
+            _tempHistory[idx].push(now, NAN, _quality[idx]);
+            _rhHistory[idx].push(now, NAN, _quality[idx]);
+        }
+        publishSnapshot();
+        _lastAttemptMs[idx] = now;
+        adaptInterval(idx, ok, now);
+        noteWarmup(idx, ok, now);
+
+        _currentSensorIndex = (_currentSensorIndex + 1) % SENSOR_COUNT;
+        _opTimestamp = now;
+        _status = ReadStatus::IDLE;
+    }
+
+    // ==== Sample history (acquisition side only) ====
+    static constexpr uint16_t HISTORY_CAPACITY = 64;               // 10 min at the fastest poll interval
+    static constexpr unsigned long HISTORY_WINDOW_MS = 10 * 60 * 1000UL;
+    SampleHistory<HISTORY_CAPACITY> _tempHistory[SENSOR_COUNT];
+    SampleHistory<HISTORY_CAPACITY> _rhHistory[SENSOR_COUNT];
+    std::atomic<bool> _historyReset{false};     // roles changed - drop the old samples
+    std::atomic<uint8_t> _roleReset{0};         // roles reassigned one by one (assignRole)
+
+    // Start the given roles over: no values, filter state or history from the old address
+    void resetRoles(uint8_t mask) {
+        if (!mask) return;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            if (!(mask & (1 << i))) continue;
+            _lastTemp[i] = NAN;
+            _lastRH[i] = NAN;
+            _lastReadMs[i] = 0;
+            _quality[i] = SensorQuality::Missing;
+            _firstValidMs[i] = 0;
+            _tempHistory[i].clear();
+            _rhHistory[i].clear();
+            _tempFilter[i].reset();
+            _rhFilter[i].reset();
+        }
+        publishSnapshot();
+    }
+
+    // ==== Filters (acquisition side; configs written by setFilterConfig) ====
+    static constexpr float TEMP_MAX_RATE_PER_MIN = 1.0f;   // °C per minute
+    static constexpr float RH_MAX_RATE_PER_MIN = 5.0f;     // %RH per minute
+    SensorFilter _tempFilter[SENSOR_COUNT];
+    SensorFilter _rhFilter[SENSOR_COUNT];
+    FilterConfig _tempFilterConfig;
+    FilterConfig _rhFilterConfig;
+    std::atomic<uint32_t> _filterConfigVersion{1};
+    uint32_t _appliedFilterVersion = 0;
+
+    void applyFilterConfig() {
+        uint32_t version = _filterConfigVersion.load(std::memory_order_acquire);
+        if (version == _appliedFilterVersion) return;
+        _appliedFilterVersion = version;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            _tempFilter[i].configure(_tempFilterConfig);
+            _rhFilter[i].configure(_rhFilterConfig);
+            // Seed from the last raw value, so the role getters don't go NAN until the next read
+            if (_lastReadMs[i]) {
+                _tempFilter[i].update(_lastReadMs[i], _lastTemp[i]);
+                _rhFilter[i].update(_lastReadMs[i], _lastRH[i]);
+            }
+        }
+        publishSnapshot();
+    }
+
+    // ==== Warm-up (time to first valid reading) ====
+    std::atomic<uint8_t> _warmupPending{0};     // sensors without a first attempt yet
+    unsigned long _warmupStartMs = 0;
+    uint32_t _firstValidMs[SENSOR_COUNT] = {0};
+
+    void restartWarmup() {
+        _warmupStartMs = _clock.nowMs();
+        uint8_t owned = 0;
+        for (int i = 0; i < SENSOR_COUNT; ++i) {
+            _firstValidMs[i] = 0;
+            if (ownsRole(static_cast<SensorIndex>(i))) owned |= 1 << i;
+        }
+        _warmupPending.store(owned, std::memory_order_relaxed);
+        _historyReset.store(true);
+    }
+
+    bool isWarmingUp(int idx) const { return _warmupPending.load(std::memory_order_relaxed) & (1 << idx); }
+
+    void noteWarmup(int idx, bool ok, unsigned long now) {
+        if (ok && !_firstValidMs[idx]) {
+            unsigned long elapsed = now - _warmupStartMs;
+            _firstValidMs[idx] = elapsed ? elapsed : 1;
+            Serial.printf("%s %s: first valid reading after %lums\n", _tag,
+                          roleName(static_cast<SensorIndex>(idx)), _firstValidMs[idx]);
+        }
+        if (!isWarmingUp(idx)) return;
+        if (_warmupPending.fetch_and(~(1 << idx), std::memory_order_relaxed) == (1 << idx)) {
+            Serial.printf("%s Warm-up done: %d/%d sensors valid after %lums\n", _tag,
+                          goodSensorCount(), ownedCount(), now - _warmupStartMs);
+        }
     }
 
-    // ==== Read functions ====
+    // ==== Bus statistics (updated by the acquisition side) ====
+    SensorStats _stats[SENSOR_COUNT];
+    uint32_t _busBusyMs = 0;
+    unsigned long _statsSinceMs = 0;
+
+    void recordResult(int idx, ModbusResult result, unsigned long busyMs, unsigned long now) {
+        SensorStats& st = _stats[idx];
+        st.requests++;
+        _busBusyMs += busyMs;
+        switch (result) {
+            case ModbusResult::Success: {
+                st.success++;
+                st.lastGoodMs = now;
+                uint32_t latencyUs = _bus.lastLatencyUs();
+                st.latencySumUs += latencyUs;
+                if (latencyUs > st.latencyMaxUs) st.latencyMaxUs = latencyUs;
+                int bucket = 0;
+                while (bucket < LATENCY_BUCKETS - 1 && latencyUs / 1000 >= bucketLimitMs(bucket)) bucket++;
+                st.latencyHist[bucket]++;
+                break;
+            }
+            case ModbusResult::Timeout:   st.timeouts++; break;
+            case ModbusResult::CrcError:  st.crcErrors++; break;
+            case ModbusResult::Exception: st.exceptions++; break;
+            default:                      st.invalid++; break;
+        }
+    }
+
+    // ==== Adaptive scheduling ====
+    bool isPriority(int idx) const { return getPrioritySensors() & (1 << idx); }
+
+    unsigned long effectiveInterval(int idx) const {
+        unsigned long interval = _sensorReadIntervalMs[idx];
+        // A sensor that just became a priority doesn't wait out its old, long interval
+        if (isPriority(idx) && interval > 2 * PRIORITY_INTERVAL_MS) interval = 2 * PRIORITY_INTERVAL_MS;
+        return (unsigned long)(interval * _budgetScale);
+    }
+
+    void adaptInterval(int idx, bool ok, unsigned long now) {
+        _txnCostMs[idx] += COST_EMA_ALPHA * ((float)_cycleBusyMs - _txnCostMs[idx]);
+
+        unsigned long current = _sensorReadIntervalMs[idx];
+        unsigned long base = isPriority(idx) ? PRIORITY_INTERVAL_MS : _baseIntervalMs[idx];
+        unsigned long ceiling = isPriority(idx) ? 2 * PRIORITY_INTERVAL_MS : MAX_INTERVAL_MS;
+        unsigned long fastest = MIN_INTERVAL_MS;
+        unsigned long next = base;
+
+        if (!ok) {
+            next = min(ceiling, current * 2);  // back off an offline sensor
+        } else if (_prevReadMs && !isnan(_prevTemp) && now > _prevReadMs) {
+            float minutes = (now - _prevReadMs) / 60000.0f;
+            float score = max(fabsf(_lastTemp[idx] - _prevTemp) / FAST_TEMP_PER_MIN,
+                              fabsf(_lastRH[idx] - _prevRH) / FAST_RH_PER_MIN) / minutes;
+            if (score >= 1.0f) next = max(fastest, base / 2);                       // changing quickly
+            else if (score < 0.25f) next = min(ceiling, max(base, current * 3 / 2)); // stable - stretch
+        }
+        _sensorReadIntervalMs[idx] = next;
+
+        // Keep the estimated bus time under the budget
+        float util = getBusUtilization();
+        _budgetScale = (util > _busBudget) ? util / _busBudget : 1.0f;
+    }
+
+    // ==== Blocking reads (setup only) ====
     // Read humidity (returns %RH, float)
     float readHumidity(SensorIndex idx) {
-        if (idx < 0 || idx > SENSOR_COUNT) return NAN;
-        uint8_t result = _modbus[idx]->readInputRegisters(0x0000, 1);
-        if (result == ModbusMaster::ku8MBSuccess) {
-            int16_t raw = _modbus[idx]->getResponseBuffer(0);
-            return raw / 10.0f;
-        }
-        return NAN;
+        if (idx < 0 || idx >= SENSOR_COUNT) return NAN;
+        if (_bus.readInputRegistersBlocking(_sensorAddr[idx], 0x0000, 1, RESPONSE_TIMEOUT_MS) != ModbusResult::Success) return NAN;
+        return (int16_t)_bus.getRegister(0) / 10.0f;
     }
 
     // Read temperature (returns °C, float)
     float readTemperature(SensorIndex idx) {
-        if (idx < 0 || idx > SENSOR_COUNT) return NAN;
-        uint8_t result = _modbus[idx]->readInputRegisters(0x0001, 1);
-        if (result == ModbusMaster::ku8MBSuccess) {
-            int16_t raw = _modbus[idx]->getResponseBuffer(0);
-            return raw / 10.0f;
-        }
-        return NAN;
+        if (idx < 0 || idx >= SENSOR_COUNT) return NAN;
+        if (_bus.readInputRegistersBlocking(_sensorAddr[idx], 0x0001, 1, RESPONSE_TIMEOUT_MS) != ModbusResult::Success) return NAN;
+        return (int16_t)_bus.getRegister(0) / 10.0f;
+    }
+
+    // Read RH and temperature in one request (registers 0x0000-0x0001)
+    bool readBoth(SensorIndex idx, float& temp, float& rh) {
+        temp = NAN;
+        rh = NAN;
+        if (idx < 0 || idx >= SENSOR_COUNT) return false;
+        if (_bus.readInputRegistersBlocking(_sensorAddr[idx], 0x0000, 2, RESPONSE_TIMEOUT_MS) != ModbusResult::Success) return false;
+        rh = (int16_t)_bus.getRegister(0) / 10.0f;
+        temp = (int16_t)_bus.getRegister(1) / 10.0f;
+        return true;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <Arduino.h>
+#include "SensorSnapshot.h"
+
+/**
+ * SampleHistory
+ *
+ * Fixed-capacity ring of timestamped samples (one sensor channel) with sliding
+ * window statistics over the last windowMs, maintained incrementally:
+ *
+ *  - mean and least-squares slope from running sums, updated on push/evict
+ *  - min and max from monotonic queues of sample sequence numbers
+ *
+ * so push() and stats() are amortized O(1) no matter how long the window is.
+ * Only Good samples with a value count towards the statistics; failed reads
+ * are kept in the ring (with their quality) so gaps stay visible.
+ *
+ * Timestamps are millis(); the sums use minutes relative to a base that is
+ * moved forward (rebuilding the sums once) every REBASE_MINUTES, which also
+ * drops accumulated rounding error. Not thread-safe - one owner.
+ */
+
+struct Sample {
+    uint32_t ms = 0;
+    float value = NAN;
+    SensorQuality quality = SensorQuality::Missing;
+};
+
+template <uint16_t CAPACITY>
+class SampleHistory {
+public:
+    explicit SampleHistory(uint32_t windowMs = 10 * 60 * 1000UL) : _windowMs(windowMs) {}
+
+    void push(uint32_t ms, float value, SensorQuality quality) {
+        expire(ms);
+        if (_count == CAPACITY) evictOldest();
+
+        bool good = quality == SensorQuality::Good && !isnan(value);
+        if (good) {
+            if (_n == 0) _baseMs = ms;
+            else if (ms - _baseMs > REBASE_MINUTES * 60000UL) rebase(ms);
+        }
+
+        uint32_t seq = _nextSeq++;
+        Sample& s = _buf[seq % CAPACITY];
+        s.ms = ms;
+        s.value = value;
+        s.quality = quality;
+        _count++;
+
+        if (!good) return;
+        add(s, 1);
+
+        while (!_minQ.empty() && at(_minQ.back()).value >= value) _minQ.popBack();
+        _minQ.pushBack(seq);
+        while (!_maxQ.empty() && at(_maxQ.back()).value <= value) _maxQ.popBack();
+        _maxQ.pushBack(seq);
+    }
+
+    // Statistics over the samples no older than windowMs at `now`
+    WindowStats stats(uint32_t now) {
+        expire(now);
+        WindowStats st;
+        st.count = _n;
+        st.samples = _count;
+        if (_n == 0) return st;
+
+        st.mean = _sumV / _n;
+        st.min = at(_minQ.front()).value;
+        st.max = at(_maxQ.front()).value;
+        st.oldestMs = at(_nextSeq - _count).ms;
+        st.newestMs = at(_nextSeq - 1).ms;
+
+        double denom = _n * _sumTT - _sumT * _sumT;
+        if (_n >= 2 && denom > 1e-9) st.slopePerMin = (_n * _sumTV - _sumT * _sumV) / denom;
+        return st;
+    }
+
+    void clear() {
+        _count = 0;
+        _n = 0;
+        _sumT = _sumV = _sumTT = _sumTV = 0;
+        _minQ.clear();
+        _maxQ.clear();
+    }
+
+    void setWindow(uint32_t windowMs) { _windowMs = windowMs; }
+    uint32_t window() const { return _windowMs; }
+
+    // Raw samples, 0 = oldest
+    uint16_t size() const { return _count; }
+    const Sample& sample(uint16_t i) const { return at(_nextSeq - _count + i); }
+
+private:
+    static constexpr uint32_t REBASE_MINUTES = 60;
+
+    // Ring of sequence numbers; never holds more than CAPACITY entries
+    struct SeqQueue {
+        uint32_t items[CAPACITY];
+        uint16_t head = 0;
+        uint16_t len = 0;
+
+        bool empty() const { return len == 0; }
+        uint32_t front() const { return items[head]; }
+        uint32_t back() const { return items[(head + len - 1) % CAPACITY]; }
+        void pushBack(uint32_t seq) { items[(head + len++) % CAPACITY] = seq; }
+        void popBack() { --len; }
+        void popFront() { head = (head + 1) % CAPACITY; --len; }
+        void clear() { head = len = 0; }
+    };
+
+    Sample _buf[CAPACITY];
+    uint32_t _windowMs;
+    uint32_t _nextSeq = 0;      // sequence number of the next sample
+    uint16_t _count = 0;        // samples in the ring (oldest is _nextSeq - _count)
+
+    // Running sums over the Good samples, t in minutes since _baseMs
+    uint16_t _n = 0;
+    uint32_t _baseMs = 0;
+    double _sumT = 0, _sumV = 0, _sumTT = 0, _sumTV = 0;
+
+    SeqQueue _minQ;             // increasing values, front = window min
+    SeqQueue _maxQ;             // decreasing values, front = window max
+
+    const Sample& at(uint32_t seq) const { return _buf[seq % CAPACITY]; }
+
+    static bool counts(const Sample& s) { return s.quality == SensorQuality::Good && !isnan(s.value); }
+
+    void add(const Sample& s, int sign) {
+        double t = (int32_t)(s.ms - _baseMs) / 60000.0;
+        _n += sign;
+        _sumT += sign * t;
+        _sumV += sign * s.value;
+        _sumTT += sign * t * t;
+        _sumTV += sign * t * s.value;
+    }
+
+    void evictOldest() {
+        uint32_t seq = _nextSeq - _count;
+        const Sample& s = at(seq);
+        if (counts(s)) {
+            add(s, -1);
+            if (!_minQ.empty() && _minQ.front() == seq) _minQ.popFront();
+            if (!_maxQ.empty() && _maxQ.front() == seq) _maxQ.popFront();
+        }
+        _count--;
+        if (_n == 0) _sumT = _sumV = _sumTT = _sumTV = 0;
+    }
+
+    void expire(uint32_t now) {
+        while (_count && now - at(_nextSeq - _count).ms > _windowMs) evictOldest();
+    }
+
+    void rebase(uint32_t newBaseMs) {
+        _baseMs = newBaseMs;
+        _n = 0;
+        _sumT = _sumV = _sumTT = _sumTV = 0;
+        for (uint32_t seq = _nextSeq - _count; seq != _nextSeq; ++seq) {
+            if (counts(at(seq))) add(at(seq), 1);
+        }
+    }
+};
@@ -27,43 +27,70 @@ public:
 private:
   std::vector<ScheduleEntry> schedule;
   TimeClient* timeClient;
+
+  // Last lookup, valid until the next minute at which any entry of the day starts or ends
+  const ScheduleEntry* cachedEntry = nullptr;
+  bool cacheValid = false;
+  unsigned long cacheStartMs = 0;
+  unsigned long cacheValidMs = 0;
+
+  static constexpr unsigned long MAX_CACHE_MS = 10UL * 60 * 1000;     // bounds clock corrections (NTP sync)
+  static constexpr unsigned long CLOCK_UNSET_CACHE_MS = 60UL * 1000;  // until the clock is obtained
   
 public:
   ScheduleManager(const std::vector<ScheduleEntry>& sched, TimeClient* tc) : schedule(sched), timeClient(tc) {}
   
-  // Get current schedule entry based on time
+  // Get current schedule entry based on time. The clock is read and the schedule
+  // scanned only when the cached entry's window has passed
   const ScheduleEntry* getCurrentEntry() {
     if (!timeClient) return nullptr;
+    if (cacheValid && millis() - cacheStartMs < cacheValidMs) return cachedEntry;
     
-    uint8_t currentDay = timeClient->getDayOfWeek();
-    uint8_t currentHour = timeClient->getHour();
-    uint8_t currentMin = timeClient->getMinute();
+    time_t epochTime = timeClient->getEpochTime();
+    struct tm *ptm = localtime(&epochTime);
+    uint8_t currentDay = ptm->tm_wday;
+    int currentSecond = ptm->tm_sec;
     
     // Convert current time to minutes for easier comparison
-    int currentTimeMinutes = currentHour * 60 + currentMin;
+    int currentTimeMinutes = ptm->tm_hour * 60 + ptm->tm_min;
     
+    // The match only changes at a start minute, the minute after an end, or midnight
+    int nextBoundaryMinutes = 24 * 60;
+    const ScheduleEntry* found = nullptr;
     for (const auto& entry : schedule) {
       if (entry.dayOfWeek != currentDay) continue;
       
       int startTimeMinutes = entry.startHour * 60 + entry.startMin;
       int endTimeMinutes = entry.endHour * 60 + entry.endMin;
+      if (startTimeMinutes > currentTimeMinutes && startTimeMinutes < nextBoundaryMinutes) nextBoundaryMinutes = startTimeMinutes;
+      if (endTimeMinutes + 1 > currentTimeMinutes && endTimeMinutes + 1 < nextBoundaryMinutes) nextBoundaryMinutes = endTimeMinutes + 1;
+      if (found) continue;
       
       // Handle overnight periods (e.g., 23:00 to 07:00)
       if (startTimeMinutes > endTimeMinutes) {
         if (currentTimeMinutes >= startTimeMinutes || currentTimeMinutes <= endTimeMinutes) {
-          return &entry;
+          found = &entry;
         }
       } else {
         // Normal period (e.g., 07:00 to 19:00)
         if (currentTimeMinutes >= startTimeMinutes && currentTimeMinutes <= endTimeMinutes) {
-          return &entry;
+          found = &entry;
         }
       }
     }
     
-    return nullptr; // No matching entry found
+    unsigned long validMs = (unsigned long)((nextBoundaryMinutes - currentTimeMinutes) * 60 - currentSecond) * 1000;
+    unsigned long limitMs = timeClient->getHasClkObtained() ? MAX_CACHE_MS : CLOCK_UNSET_CACHE_MS;
+    cachedEntry = found; // nullptr when no entry matches
+    cacheStartMs = millis();
+    cacheValidMs = validMs < limitMs ? validMs : limitMs;
+    cacheValid = true;
+    return found;
   }
   
+  // Forget the cached entry, e.g. after the clock was set
+  void invalidateCache() { cacheValid = false; }
+  
   // Get fan speed for current time (with interpolation)
   int getCurrentFanSpeed() {
     const ScheduleEntry* entry = getCurrentEntry();
@@ -0,0 +1,107 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * SensorFilter
+ *
+ * Streaming filter for one sensor channel, O(1) per sample:
+ *
+ *   raw -> median of the last medianN (spike rejection)
+ *       -> rate-of-change limit (maxRatePerMin, scaled by the time since the last sample)
+ *       -> EMA (emaAlpha; 1 = no smoothing)
+ *
+ * A single glitch never reaches the output with medianN >= 3, and the rate
+ * limit bounds how far a burst of bad samples can drag it. After a gap longer
+ * than resetAfterMs (sensor offline) the filter restarts from the next raw
+ * value instead of slewing towards it.
+ */
+
+struct FilterConfig {
+    static constexpr uint8_t MAX_MEDIAN = 5;
+
+    uint8_t medianN = 3;            // 1 (off), 3 or 5
+    float emaAlpha = 0.4f;          // weight of the new sample, (0, 1]
+    float maxRatePerMin = 0;        // largest accepted change per minute, 0 = no limit
+    uint32_t resetAfterMs = 10 * 60 * 1000UL;
+
+    bool operator==(const FilterConfig& other) const {
+        return medianN == other.medianN && emaAlpha == other.emaAlpha &&
+               maxRatePerMin == other.maxRatePerMin && resetAfterMs == other.resetAfterMs;
+    }
+    bool operator!=(const FilterConfig& other) const { return !(*this == other); }
+};
+
+class SensorFilter {
+public:
+    void configure(const FilterConfig& config) {
+        _config = config;
+        uint8_t maxMedian = FilterConfig::MAX_MEDIAN;
+        _config.medianN = constrain(_config.medianN, 1, maxMedian) | 1; // odd
+        _config.emaAlpha = constrain(_config.emaAlpha, 0.01f, 1.0f);
+        reset();
+    }
+
+    const FilterConfig& config() const { return _config; }
+
+    // Feed a good raw sample; returns the filtered value. After configure() / reset()
+    // the first sample seeds the filter as is.
+    float update(uint32_t ms, float raw) {
+        if (isnan(raw)) return _filtered;
+        if (_count == 0 || ms - _lastMs > _config.resetAfterMs) {
+            reset();
+            _window[0] = raw;
+            _count = 1;
+            _next = 1 % _config.medianN;
+            _limitedValue = _filtered = raw;
+            _lastMs = ms;
+            return _filtered;
+        }
+
+        _window[_next] = raw;
+        _next = (_next + 1) % _config.medianN;
+        if (_count < _config.medianN) _count++;
+        float value = median();
+
+        if (_config.maxRatePerMin > 0) {
+            float maxDelta = _config.maxRatePerMin * (ms - _lastMs) / 60000.0f;
+            if (value > _limitedValue + maxDelta) { value = _limitedValue + maxDelta; _limited++; }
+            else if (value < _limitedValue - maxDelta) { value = _limitedValue - maxDelta; _limited++; }
+        }
+        _limitedValue = value;
+
+        _filtered += _config.emaAlpha * (value - _filtered);
+        _lastMs = ms;
+        return _filtered;
+    }
+
+    void reset() {
+        _count = 0;
+        _next = 0;
+        _filtered = NAN;
+    }
+
+    float value() const { return _filtered; }
+    uint32_t limitedCount() const { return _limited; }  // samples clipped by the rate limit
+
+private:
+    FilterConfig _config;
+    float _window[FilterConfig::MAX_MEDIAN];
+    uint8_t _count = 0;
+    uint8_t _next = 0;
+    float _limitedValue = NAN;    // output of the rate limit stage
+    float _filtered = NAN;
+    uint32_t _lastMs = 0;
+    uint32_t _limited = 0;
+
+    // Insertion sort of at most MAX_MEDIAN values
+    float median() const {
+        float sorted[FilterConfig::MAX_MEDIAN];
+        for (uint8_t i = 0; i < _count; ++i) {
+            float v = _window[i];
+            uint8_t j = i;
+            for (; j > 0 && sorted[j - 1] > v; --j) sorted[j] = sorted[j - 1];
+            sorted[j] = v;
+        }
+        return sorted[_count / 2];
+    }
+};
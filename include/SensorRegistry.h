@@ -0,0 +1,218 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * SensorRegistry
+ *
+ * One place where the controller's sensor channels are declared: a channel is
+ * a role ("room", "roof", "cooler2_before", ...) and a quantity, served by a
+ * channel of some SensorSource (a bus manager: RS485, I2C, 1-Wire). Channels
+ * are added at runtime - from setup() or from the systemConfig "sensors" array -
+ * and consumers look them up by role, so a new sensor is configuration, not a
+ * new getter.
+ *
+ * tick() drives every source that needs driving from the loop, round-robin
+ * within a CPU budget per call: a source that overruns it makes the next call
+ * start with the following source, so one slow bus can't starve the others.
+ * Bus time is budgeted inside each source (see SHTManager_RS485::setBusBudget).
+ *
+ * find() is a linear search over roles - call it once and keep the id;
+ * value(id) is O(1).
+ */
+
+enum class SensorQuantity : uint8_t { Temperature, Humidity };
+
+// A bus manager seen through the registry
+class SensorSource {
+public:
+    virtual ~SensorSource() {}
+
+    virtual const char* name() const = 0;
+
+    // Advance acquisition without blocking; sources that run their own task do nothing
+    virtual void tick() {}
+
+    // Latest (unexpired) value of one of the source's channels
+    virtual bool read(uint16_t channel, SensorQuantity quantity, float& value, uint32_t& readMs) const = 0;
+
+    // Requested sampling interval for a channel; sources may adapt around it
+    virtual void setInterval(uint16_t channel, uint32_t intervalMs) { (void)channel; (void)intervalMs; }
+
+    // Share of time the bus spent in transactions, if the source measures it
+    virtual float busUtilization() const { return 0; }
+};
+
+class SensorRegistry {
+public:
+    static constexpr uint8_t MAX_SOURCES = 6;
+    static constexpr uint8_t MAX_CHANNELS = 32;
+    static constexpr uint8_t MAX_ROLE_LEN = 23;
+    static constexpr int NOT_FOUND = -1;
+
+    bool addSource(SensorSource* source) {
+        if (!source || _sourceCount >= MAX_SOURCES || findSource(source->name())) return false;
+        _sources[_sourceCount++].source = source;
+        return true;
+    }
+
+    SensorSource* findSource(const char* name) const {
+        for (uint8_t i = 0; i < _sourceCount; ++i) {
+            if (strcmp(_sources[i].source->name(), name) == 0) return _sources[i].source;
+        }
+        return nullptr;
+    }
+
+    // Declare (or re-point) a channel. Returns its id, NOT_FOUND if the table is full.
+    int addChannel(const char* role, SensorQuantity quantity, SensorSource* source,
+                   uint16_t sourceChannel, uint32_t intervalMs) {
+        if (!source || !role || !*role) return NOT_FOUND;
+        int id = find(role, quantity);
+        if (id == NOT_FOUND) {
+            if (_channelCount >= MAX_CHANNELS) {
+                Serial.printf("[Sensors] Channel table full, can't add '%s'\n", role);
+                return NOT_FOUND;
+            }
+            id = _channelCount++;
+        }
+        Channel& ch = _channels[id];
+        strncpy(ch.role, role, MAX_ROLE_LEN);
+        ch.role[MAX_ROLE_LEN] = '\0';
+        ch.quantity = quantity;
+        ch.source = source;
+        ch.sourceChannel = sourceChannel;
+        ch.intervalMs = intervalMs;
+        if (intervalMs) source->setInterval(sourceChannel, intervalMs);
+        return id;
+    }
+
+    int addChannel(const char* role, SensorQuantity quantity, const char* sourceName,
+                   uint16_t sourceChannel, uint32_t intervalMs) {
+        SensorSource* source = findSource(sourceName);
+        if (!source) {
+            Serial.printf("[Sensors] Unknown bus '%s' for '%s'\n", sourceName, role);
+            return NOT_FOUND;
+        }
+        return addChannel(role, quantity, source, sourceChannel, intervalMs);
+    }
+
+    // [{"role": "roof", "bus": "rs485", "channel": 4, "quantity": "temp" | "rh", "intervalS": 60}, ...]
+    int addChannelsFromJson(JsonArrayConst channels) {
+        int added = 0;
+        for (JsonObjectConst ch : channels) {
+            const char* role = ch["role"] | "";
+            const char* bus = ch["bus"] | "";
+            const char* quantity = ch["quantity"] | "temp";
+            uint16_t channel = ch["channel"] | 0;
+            uint32_t intervalMs = (ch["intervalS"] | 0) * 1000UL;
+            SensorQuantity q = strcmp(quantity, "rh") == 0 ? SensorQuantity::Humidity : SensorQuantity::Temperature;
+            if (addChannel(role, q, bus, channel, intervalMs) != NOT_FOUND) ++added;
+        }
+        return added;
+    }
+
+    int find(const char* role, SensorQuantity quantity) const {
+        for (uint8_t i = 0; i < _channelCount; ++i) {
+            if (_channels[i].quantity == quantity && strcmp(_channels[i].role, role) == 0) return i;
+        }
+        return NOT_FOUND;
+    }
+
+    // NAN if the channel doesn't exist or has no current value
+    float value(int id) const {
+        if (id < 0 || id >= _channelCount) return NAN;
+        const Channel& ch = _channels[id];
+        float v;
+        uint32_t readMs;
+        return ch.source->read(ch.sourceChannel, ch.quantity, v, readMs) ? v : NAN;
+    }
+
+    float value(const char* role, SensorQuantity quantity) const { return value(find(role, quantity)); }
+
+    // ms since the channel's last good reading, UINT32_MAX if it has none
+    uint32_t age(int id) const {
+        if (id < 0 || id >= _channelCount) return UINT32_MAX;
+        const Channel& ch = _channels[id];
+        float v;
+        uint32_t readMs;
+        return ch.source->read(ch.sourceChannel, ch.quantity, v, readMs) ? millis() - readMs : UINT32_MAX;
+    }
+
+    uint8_t channelCount() const { return _channelCount; }
+    const char* role(int id) const { return (id >= 0 && id < _channelCount) ? _channels[id].role : ""; }
+    SensorQuantity quantity(int id) const { return _channels[id].quantity; }
+
+    void setCpuBudgetUs(uint32_t us) { _cpuBudgetUs = us; }
+
+    // Drive the sources from loop(), round-robin within the CPU budget
+    void tick() {
+        uint32_t startUs = micros();
+        for (uint8_t n = 0; n < _sourceCount; ++n) {
+            SourceSlot& slot = _sources[_nextSource];
+            _nextSource = (_nextSource + 1) % _sourceCount;
+
+            uint32_t t0 = micros();
+            slot.source->tick();
+            uint32_t spent = micros() - t0;
+            if (spent > slot.maxTickUs) slot.maxTickUs = spent;
+
+            if (micros() - startUs >= _cpuBudgetUs) {
+                _budgetOverruns++;
+                break;
+            }
+        }
+    }
+
+    // Telemetry keys: sensor_<role>_<temp|rh>, only for channels with a current value
+    void toJson(JsonObject obj) const {
+        char key[48];
+        for (uint8_t i = 0; i < _channelCount; ++i) {
+            float v = value(i);
+            if (isnan(v)) continue;
+            snprintf(key, sizeof(key), "sensor_%s_%s", _channels[i].role,
+                     _channels[i].quantity == SensorQuantity::Humidity ? "rh" : "temp");
+            obj[key] = v;
+        }
+    }
+
+    void printChannels() const {
+        Serial.printf("[Sensors] %u source(s), %u channel(s), CPU budget %luus per tick, %lu overrun(s)\n",
+                      _sourceCount, _channelCount, _cpuBudgetUs, _budgetOverruns);
+        for (uint8_t i = 0; i < _sourceCount; ++i) {
+            Serial.printf("[Sensors]   bus %-8s max tick %luus, bus utilization %.1f%%\n",
+                          _sources[i].source->name(), _sources[i].maxTickUs, _sources[i].source->busUtilization() * 100);
+        }
+        for (uint8_t i = 0; i < _channelCount; ++i) {
+            const Channel& ch = _channels[i];
+            uint32_t chAge = age(i);
+            Serial.printf("[Sensors]   #%-2u %-16s %-4s %s/%u every %lus: %.2f (%s)\n",
+                          i, ch.role, ch.quantity == SensorQuantity::Humidity ? "rh" : "temp",
+                          ch.source->name(), ch.sourceChannel, ch.intervalMs / 1000, value(i),
+                          chAge == UINT32_MAX ? "no data" : (String(chAge / 1000) + "s old").c_str());
+        }
+    }
+
+private:
+    struct Channel {
+        char role[MAX_ROLE_LEN + 1];
+        SensorQuantity quantity;
+        SensorSource* source;
+        uint16_t sourceChannel;
+        uint32_t intervalMs;
+    };
+
+    struct SourceSlot {
+        SensorSource* source = nullptr;
+        uint32_t maxTickUs = 0;
+    };
+
+    SourceSlot _sources[MAX_SOURCES];
+    uint8_t _sourceCount = 0;
+    uint8_t _nextSource = 0;
+
+    Channel _channels[MAX_CHANNELS];
+    uint8_t _channelCount = 0;
+
+    uint32_t _cpuBudgetUs = 2000;
+    uint32_t _budgetOverruns = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * SensorSnapshot
+ *
+ * Versioned copy of the RS485 sensor readings, published by the acquisition
+ * task and read by the control loop, telemetry and ExperimentManager.
+ *
+ * SeqLockBuffer is a single-writer double buffer: the writer fills the
+ * inactive slot and then bumps the sequence, readers copy the active slot
+ * and retry if the sequence moved while they were copying. Neither side
+ * ever blocks the other.
+ */
+
+enum class SensorQuality : uint8_t {
+    Missing = 0,  // never read successfully
+    Good,         // the last read attempt succeeded
+    Stale         // the last attempt failed; values are from readMs
+};
+
+// Sliding-window statistics of one channel (see SampleHistory)
+struct WindowStats {
+    uint16_t count = 0;         // Good samples the statistics are computed from
+    uint16_t samples = 0;       // all samples in the window, failed reads included
+    float mean = NAN;
+    float min = NAN;
+    float max = NAN;
+    float slopePerMin = NAN;    // least-squares trend, units per minute (needs 2+ samples)
+    uint32_t oldestMs = 0;
+    uint32_t newestMs = 0;
+
+    bool valid() const { return count > 0; }
+};
+
+struct SensorReading {
+    float temp = NAN;           // raw sensor values
+    float rh = NAN;
+    uint32_t readMs = 0;        // millis() of the last good read
+    SensorQuality quality = SensorQuality::Missing;
+    float tempFiltered = NAN;   // SensorFilter output (what control uses)
+    float rhFiltered = NAN;
+    WindowStats tempWindow;
+    WindowStats rhWindow;
+
+    bool isValid(uint32_t now, uint32_t expiryMs) const {
+        return quality != SensorQuality::Missing && now - readMs < expiryMs;
+    }
+};
+
+struct SensorSnapshot {
+    static constexpr int MAX_SENSORS = 5;
+
+    uint32_t version = 0;       // sequence number of this snapshot
+    uint32_t takenMs = 0;
+    SensorReading sensors[MAX_SENSORS];
+};
+
+template <typename T>
+class SeqLockBuffer {
+public:
+    // Single writer only
+    void write(const T& value) {
+        uint32_t seq = m_seq.load(std::memory_order_relaxed);
+        m_buf[(seq + 1) & 1] = value;
+        m_seq.store(seq + 1, std::memory_order_release);
+    }
+
+    // Any number of readers; returns the sequence of the copy
+    uint32_t read(T& out) const {
+        for (;;) {
+            uint32_t before = m_seq.load(std::memory_order_acquire);
+            out = m_buf[before & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The slot we copied is only rewritten after the writer published before + 1
+            if (m_seq.load(std::memory_order_relaxed) == before) return before;
+        }
+    }
+
+    uint32_t sequence() const { return m_seq.load(std::memory_order_acquire); }
+
+private:
+    T m_buf[2];
+    std::atomic<uint32_t> m_seq{0};
+};
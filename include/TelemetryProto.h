@@ -0,0 +1,143 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * TelemetryProto
+ *
+ * Protobuf encoding of single telemetry values for ThingsBoard devices whose
+ * profile uses the Protobuf transport payload type.
+ *
+ * TELEMETRY_KEYS is the one table of telemetry keys: the encoder looks keys
+ * up in it and schema() generates the matching .proto text from it (print it
+ * with the 'protoschema' serial command and paste it into the device profile).
+ * Field numbers are part of the wire format - never reuse or renumber them,
+ * only append.
+ *
+ * Keys missing from the table, batches and attributes are sent as JSON, so the
+ * device profile should have "Enable compatibility with other payload formats"
+ * switched on.
+ *
+ * Selected at build time with -D TELEMETRY_PROTOBUF, or at runtime with the
+ * "telemetry_encoding" shared attribute ("json" / "protobuf").
+ */
+
+enum class TelemetryEncoding : uint8_t { Json, Protobuf };
+
+//  key name                        field  type
+#define TELEMETRY_KEYS(X) \
+  X(fw_state,                          1,  STRING) \
+  X(System_Status_Code,                2,  STRING) \
+  X(System_Mode,                       3,  STRING) \
+  X(Fans_Speed,                        4,  FLOAT)  \
+  X(Water_Mode,                        5,  STRING) \
+  X(Dampers_Status,                    6,  STRING) \
+  X(Drippers_Budget,                   7,  FLOAT)  \
+  X(Sprinklers_Budget,                 8,  FLOAT)  \
+  X(RS485_Ambiant_Temp,                9,  FLOAT)  \
+  X(RS485_Ambiant_RH,                 10,  FLOAT)  \
+  X(RS485_Before_Temp,                11,  FLOAT)  \
+  X(RS485_Before_RH,                  12,  FLOAT)  \
+  X(RS485_After_Temp,                 13,  FLOAT)  \
+  X(RS485_After_RH,                   14,  FLOAT)  \
+  X(RS485_Room_Temp,                  15,  FLOAT)  \
+  X(RS485_Room_RH,                    16,  FLOAT)  \
+  X(Drippers_Actual,                  17,  STRING) \
+  X(Drippers_Slot,                    18,  FLOAT)  \
+  X(Dampers_Actual,                   19,  STRING) \
+  X(Sprinklers_Mode,                  20,  STRING) \
+  X(Sprinklers_Actual,                21,  STRING) \
+  X(Sprinklers_Slot,                  22,  FLOAT)  \
+  X(Regeneration_Status,              23,  STRING) \
+  X(InnerFan_Voltage,                 24,  FLOAT)  \
+  X(InnerFan_PWM,                     25,  FLOAT)  \
+  X(Current_Time,                     26,  STRING) \
+  X(OTA_Status,                       27,  STRING) \
+  X(OTA_Health_Progress,              28,  FLOAT)  \
+  X(OTA_Health_Remaining,             29,  FLOAT)  \
+  X(OTA_Validation_Time_Elapsed,      30,  FLOAT)  \
+  X(OTA_Validation_Time_Remaining,    31,  FLOAT)  \
+  X(OTA_System_Healthy,               32,  FLOAT)  \
+  X(OTA_Last_Loop_Time,               33,  FLOAT)  \
+  X(OTA_Firmware_Version,             34,  STRING) \
+  X(fw_version_validated,             35,  STRING) \
+  X(fw_validation_time,               36,  FLOAT)  \
+  X(fw_rollback_reason,               37,  STRING) \
+  X(fw_validation_progress,           38,  FLOAT)  \
+  X(fw_validation_remaining,          39,  FLOAT)  \
+  X(fw_validation_time_elapsed,       40,  FLOAT)  \
+  X(fw_validation_time_remaining,     41,  FLOAT)  \
+  X(fw_version_validating,            42,  STRING) \
+  X(fw_error,                         43,  STRING) \
+  X(fw_control_outage_ms,             44,  FLOAT)
+
+namespace TelemetryProto {
+
+enum class FieldType : uint8_t { FLOAT, STRING };
+
+struct KeyInfo {
+  const char* name;
+  uint8_t field;
+  FieldType type;
+};
+
+#define TELEMETRY_PROTO_KEY_INFO(name, field, type) { #name, field, FieldType::type },
+static const KeyInfo KEYS[] = { TELEMETRY_KEYS(TELEMETRY_PROTO_KEY_INFO) };
+#undef TELEMETRY_PROTO_KEY_INFO
+
+static constexpr size_t KEY_COUNT = sizeof(KEYS) / sizeof(KEYS[0]);
+
+inline const KeyInfo* findKey(const char* name) {
+  for (size_t i = 0; i < KEY_COUNT; ++i) {
+    if (strcmp(KEYS[i].name, name) == 0) return &KEYS[i];
+  }
+  return nullptr;
+}
+
+// ==== Wire format helpers ====
+inline size_t writeVarint(uint8_t* buf, size_t cap, uint32_t value) {
+  size_t n = 0;
+  do {
+    if (n >= cap) return 0;
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    buf[n++] = value ? (byte | 0x80) : byte;
+  } while (value);
+  return n;
+}
+
+// Encodes one float field (wire type 5). Returns bytes written, 0 on error.
+inline size_t encodeFloat(uint8_t* buf, size_t cap, const KeyInfo& key, float value) {
+  if (key.type != FieldType::FLOAT) return 0;
+  size_t n = writeVarint(buf, cap, ((uint32_t)key.field << 3) | 5);
+  if (n == 0 || n + 4 > cap) return 0;
+  memcpy(buf + n, &value, 4); // ESP32 is little-endian, same as the wire format
+  return n + 4;
+}
+
+// Encodes one string field (wire type 2). Returns bytes written, 0 on error.
+inline size_t encodeString(uint8_t* buf, size_t cap, const KeyInfo& key, const char* value, size_t length) {
+  if (key.type != FieldType::STRING) return 0;
+  size_t n = writeVarint(buf, cap, ((uint32_t)key.field << 3) | 2);
+  if (n == 0) return 0;
+  size_t m = writeVarint(buf + n, cap - n, (uint32_t)length);
+  if (m == 0 || n + m + length > cap) return 0;
+  memcpy(buf + n + m, value, length);
+  return n + m + length;
+}
+
+// .proto text for the ThingsBoard device profile, generated from TELEMETRY_KEYS
+inline String schema() {
+  String proto = "syntax = \"proto3\";\npackage thermoterra;\n\nmessage Telemetry {\n";
+  for (size_t i = 0; i < KEY_COUNT; ++i) {
+    proto += "  optional ";
+    proto += (KEYS[i].type == FieldType::FLOAT) ? "float " : "string ";
+    proto += KEYS[i].name;
+    proto += " = ";
+    proto += String(KEYS[i].field);
+    proto += ";\n";
+  }
+  proto += "}\n";
+  return proto;
+}
+
+} // namespace TelemetryProto
@@ -34,6 +34,14 @@ bool init_NTP_realtime_clk(){
     }
 }
 
+/// @brief current epoch: NTP when it's set, otherwise the system clock
+///        (restored from the RTC at boot), so the time is valid offline
+time_t now(){
+    if (WiFi.status() == WL_CONNECTED) ntpClient->update();
+    if (ntpClient->isTimeSet()) return ntpClient->getEpochTime();
+    return time(nullptr);
+}
+
 public:
 
     TimeClient(){
@@ -45,9 +53,8 @@ public:
     /// @return formated time Y-m-d H:M:S
     String getFormattedTime(){
         
-        ntpClient->update();
         // Get the current epoch time
-        time_t epochTime = ntpClient->getEpochTime();
+        time_t epochTime = now();
 
         // Convert epoch time to tm structure
         struct tm *ptm = gmtime(&epochTime);
@@ -60,9 +67,8 @@ public:
         return String(timeString);
     }
     int getHour(){
-        ntpClient->update();
         // Get the current epoch time
-        time_t epochTime = ntpClient->getEpochTime();
+        time_t epochTime = now();
 
         // Convert epoch time to tm structure using local time
         struct tm *ptm = localtime(&epochTime);
@@ -70,9 +76,8 @@ public:
         return ptm->tm_hour;
     }
     int getMinute(){
-        ntpClient->update();
         // Get the current epoch time
-        time_t epochTime = ntpClient->getEpochTime();
+        time_t epochTime = now();
 
         // Convert epoch time to tm structure using local time
         struct tm *ptm = localtime(&epochTime);
@@ -81,9 +86,8 @@ public:
     }
     
     int getDayOfWeek(){
-        ntpClient->update();
         // Get the current epoch time
-        time_t epochTime = ntpClient->getEpochTime();
+        time_t epochTime = now();
 
         // Convert epoch time to tm structure using local time
         struct tm *ptm = localtime(&epochTime);
@@ -93,16 +97,16 @@ public:
     }
 
     bool getHasClkObtained(){
-        return realtime_clk_obtained;
+        return realtime_clk_obtained || ntpClient->isTimeSet();
     }
 
     // Update the NTP client
     void update(){
         
-        ntpClient->update();
+        if (WiFi.status() == WL_CONNECTED) ntpClient->update();
     }
     
     unsigned long getEpochTime(){
-        return ntpClient->getEpochTime();
+        return now();
     }
 };
\ No newline at end of file
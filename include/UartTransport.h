@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+#include "driver/uart.h"
+#include "ModbusTransport.h"
+
+// The device clock for ModbusClock users
+class ArduinoClock : public ModbusClock {
+public:
+    uint32_t nowMs() override { return millis(); }
+    uint32_t nowUs() override { return micros(); }
+    void sleepMs(uint32_t ms) override { delay(ms); }
+};
+
+// The UART drives DE/RE itself (RS485 half-duplex mode, DE/RE on its RTS
+// line): the transceiver turns around right after the last stop bit, not at
+// the next poll(), so a sensor answering after 3.5 characters isn't cut off.
+class UartTransport : public ModbusTransport {
+public:
+    UartTransport(HardwareSerial& serial, uart_port_t uartNum, int8_t rxPin, int8_t txPin, uint8_t dePin)
+        : _serial(serial), _uartNum(uartNum), _rxPin(rxPin), _txPin(txPin), _dePin(dePin) {}
+
+    void begin(uint32_t baud) override {
+        _serial.begin(baud, SERIAL_8N1, _rxPin, _txPin);
+        uart_set_pin(_uartNum, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, _dePin, UART_PIN_NO_CHANGE);
+        if (uart_set_mode(_uartNum, UART_MODE_RS485_HALF_DUPLEX) != ESP_OK) {
+            Serial.printf("[RS485] UART%d: RS485 half-duplex mode not available\n", (int)_uartNum);
+        }
+    }
+
+    void send(const uint8_t* frame, size_t length) override {
+        _serial.write(frame, length);
+    }
+
+    bool sendDone() override { return uart_wait_tx_done(_uartNum, 0) == ESP_OK; }
+
+    void listen() override {}  // DE/RE already released by the UART
+
+    int available() override { return _serial.available(); }
+    int read() override { return _serial.read(); }
+
+    ModbusClock& clock() override { return _clock; }
+
+private:
+    HardwareSerial& _serial;
+    uart_port_t _uartNum;
+    int8_t _rxPin;
+    int8_t _txPin;
+    uint8_t _dePin;
+    ArduinoClock _clock;
+};
@@ -6,7 +6,13 @@
 #include <OneWire.h>
 #include <algorithm>
 #include "esp_task_wdt.h"
-#include "SHTManager_RS485.h"
+#include "esp_sntp.h"
+#include "UartTransport.h"
+#include "RS485BusGroup.h"
+#include "ModbusFrameRecorder.h"
+#include "SensorRegistry.h"
+#include "SHTManager_I2C.h"
+#include "DallasManager.h"
 #include "TimeClient.h"
 #include "S3Log.h"
 #include "OTAManager.h"
@@ -17,6 +23,7 @@
 #include "ExperimentManager.h"
 #include "ScheduleManager.h"
 #include "SystemTypes.h"
+#include "LogManager.h"
 
 // ===========================
 // Wifi credentials
@@ -48,6 +55,7 @@ const unsigned long HEARTBEAT_INTERVAL = 30 * 1000;  // 30 seconds heartbeat
 WiFiClient wiFiClient;
 PubSubClient mqttClient(wiFiClient);
 OTAManager otaManager(mqttClient, CURRENT_FIRMWARE_VERSION, TOKEN);
+LogManager logManager;
 
 const int PIN_FAN_RIGHT1 = 21;
 const int PIN_FAN_RIGHT2 = 47;
@@ -73,6 +81,9 @@ const int PUMP_PWM_RESOLUTION = 8;  // 8-bit (0–255)
 
 const int PIN_FAN_INNER1 = 8;
 const int PIN_FAN_INNER_ADC = 18;
+
+const int PIN_RTC_SDA = 7;  // RTC on the secondary I2C controller (Wire1)
+const int PIN_RTC_SCL = 6;
 //const int PIN_FAN_INNER2 = 7;
 const int FAN_INNER_CHANNEL = 2;
 const int FAN_INNER_FREQUENCY = 20000; // PWM frequency in Hz
@@ -96,7 +107,30 @@ float START_HEATING_DEG = 18.0;
 const int airValvesRelayPins[] = { PIN_DAMPER };
 
 HardwareSerial RS485Serial(2); // UART2
-SHTManager_RS485 shtRS485Manager(RS485Serial); // For RS485 sensors
+HardwareSerial RS485Serial2(1); // UART1
+UartTransport rs485Port0(RS485Serial, UART_NUM_2, RS485_RX_PIN, RS485_TX_PIN, RS485_DE_RE_PIN);
+UartTransport rs485Port1(RS485Serial2, UART_NUM_1, RS485_2_RX_PIN, RS485_2_TX_PIN, RS485_2_DE_RE_PIN);
+SHTManager_RS485 rs485Bus0(rs485Port0, 0);
+SHTManager_RS485 rs485Bus1(rs485Port1, 1);
+RS485BusGroup shtRS485Manager; // For RS485 sensors, roles routed to the bus that serves them
+RS485SensorSource rs485Source(shtRS485Manager);
+ModbusFrameRecorder rs485Recorder; // 'shtcapture': raw Modbus frames of one bus, for replay on a host
+SensorRegistry sensorRegistry; // sensor channels by role, across buses
+// Optional buses, created when systemConfig enables them ("i2cSensors", "oneWire")
+SHTManager_I2C* shtI2CManager = nullptr;
+I2CSensorSource* i2cSource = nullptr;
+DallasManager* dallasManager = nullptr;
+DallasSensorSource* oneWireSource = nullptr;
+// Registry ids of the channels control decides on, resolved in setup(); systemConfig
+// "sensors" re-points a role in place, so the ids stay valid
+int ambiantTempId = SensorRegistry::NOT_FOUND;
+int ambiantRHId = SensorRegistry::NOT_FOUND;
+int beforeTempId = SensorRegistry::NOT_FOUND;
+int beforeRHId = SensorRegistry::NOT_FOUND;
+int afterTempId = SensorRegistry::NOT_FOUND;
+int afterRHId = SensorRegistry::NOT_FOUND;
+int roomTempId = SensorRegistry::NOT_FOUND;
+int roomRHId = SensorRegistry::NOT_FOUND;
 S3Log* dataLog;
 TimeClient* timeClient;
 bool isDataSent = false;
@@ -222,6 +256,7 @@ bool debugMode = false;
 unsigned long damperActionStartTime = 0;
 const unsigned long DAMPER_ACTION_DURATION_MS = 15 * 1000;
 RTC_DS3231 rtc;
+bool rtcReady = false;
 
 // Forward declarations
 void offDrippers();
@@ -325,21 +360,26 @@ int getSystemStatusCode() {
   return status;
 }
 
-void logMessage(const String& msg) {
+void logMessage(LogLevel level, const String& msg) {
   Serial.println(msg);
-  otaManager.sendTelemetry("log", msg);
+  logManager.log(level, msg); // shipped in batches from loop()
+}
+
+void logMessage(const String& msg) {
+  logMessage(LogLevel::Info, msg);
 }
 
 void logMode() {
   logToS3("System", "system", "cooler", "mode", getSystemStatusCode()); // "mode" must be in location "cooler"
 
-  otaManager.sendTelemetry("System_Status_Code", String(getSystemStatusCode()));
-  otaManager.sendTelemetry("System_Mode", SystemModeHelper::toString(currentSystemMode));
-  otaManager.sendTelemetry("Fans_Speed", currentPWMSpeed);
-  otaManager.sendTelemetry("Water_Mode", currentWaterMode == WateringMode::On ? "Open" : "Close");
-  otaManager.sendTelemetry("Dampers_Status", currentAirMode == AirValveMode::Open ? "Open" : "Close");
-  otaManager.sendTelemetry("Drippers_Budget", (int)(wateringBudget.getBudgetDurationMs() / 1000));
-  otaManager.sendTelemetry("Sprinklers_Budget", (int)(sprinklersBudget.getBudgetDurationMs() / 1000));
+  // Only the keys that actually changed go out (plus a periodic keep-alive)
+  otaManager.sendTelemetryIfChanged("System_Status_Code", String(getSystemStatusCode()), PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("System_Mode", SystemModeHelper::toString(currentSystemMode), PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("Fans_Speed", currentPWMSpeed, PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("Water_Mode", currentWaterMode == WateringMode::On ? "Open" : "Close", PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("Dampers_Status", currentAirMode == AirValveMode::Open ? "Open" : "Close", PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("Drippers_Budget", (int)(wateringBudget.getBudgetDurationMs() / 1000), PublishPriority::State);
+  otaManager.sendTelemetryIfChanged("Sprinklers_Budget", (int)(sprinklersBudget.getBudgetDurationMs() / 1000), PublishPriority::State);
 }
 
 void onFans(int percentage) {
@@ -538,10 +578,10 @@ void setWater(WateringMode mode) {
 AirValveMode getAirModeByRoom() {
   debugMessage("get air mode by room");
   AirValveMode airMode = currentAirMode;
-  float roomRH = shtRS485Manager.getRoomRH();
+  float roomRH = sensorRegistry.value(roomRHId);
   if(isnan(roomRH)) {
     // Use fallback when humidity sensor is not available
-    logMessage("[getAirModeByRoom] Room RH not available, using fallback value: 50%");
+    logMessage(LogLevel::Warn, "[getAirModeByRoom] Room RH not available, using fallback value: 50%");
     roomRH = 50.0; // Use 50% as fallback - safe middle ground
   }
 
@@ -632,7 +672,7 @@ void setWaterBudgetFromPwm(int pwm) {
 bool isTopOfHour() {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo)) {
-    logMessage("[Regenerate] Failed to get local time, cannot determine if it's top of hour");
+    logMessage(LogLevel::Warn, "[Regenerate] Failed to get local time, cannot determine if it's top of hour");
     return false;
   }
   return timeinfo.tm_min == 0;
@@ -641,17 +681,17 @@ bool isTopOfHour() {
 
 // Helper function to update regeneration budget based on beforeRH
 void updateRegenerationBudget() {
-  float beforeRH = shtRS485Manager.getBeforeRH();
+  float beforeRH = sensorRegistry.value(beforeRHId);
   
   // Fallback value when sensor is not available
   if(isnan(beforeRH)) {
-    logMessage("[Regenerate] Before RH is not available, using fallback value: 50%");
+    logMessage(LogLevel::Warn, "[Regenerate] Before RH is not available, using fallback value: 50%");
     beforeRH = 50.0; // Use 50% as fallback - safe middle ground
   }
   
   // Safety check for valid humidity values
   if (beforeRH < 0 || beforeRH > 100) {
-    logMessage("[Regenerate] Invalid beforeRH value: " + String(beforeRH) + "%, using fallback value: 50%");
+    logMessage(LogLevel::Warn, "[Regenerate] Invalid beforeRH value: " + String(beforeRH) + "%, using fallback value: 50%");
     beforeRH = 50.0; // Use 50% as fallback
   }
   
@@ -699,22 +739,42 @@ float getInnerFansSpeed() {
 
 // Helper function to check if sensors are available for cool mode
 bool areCoolSensorsAvailable() {
-  float roomTemp = shtRS485Manager.getRoomTemp();
-  float beforeRH = shtRS485Manager.getBeforeRH();
+  float roomTemp = sensorRegistry.value(roomTempId);
+  float beforeRH = sensorRegistry.value(beforeRHId);
   return !isnan(roomTemp) && !isnan(beforeRH);
 }
 
 // Helper function to check if sensors are available for regenerate mode
 bool areRegenerateSensorsAvailable() {
-  float beforeRH = shtRS485Manager.getBeforeRH();
-  float afterRH = shtRS485Manager.getAfterRH();
+  float beforeRH = sensorRegistry.value(beforeRHId);
+  float afterRH = sensorRegistry.value(afterRHId);
   return !isnan(beforeRH) && !isnan(afterRH);
 }
 
+// RS485 sensors the given mode makes decisions on - they get polled more often
+uint8_t rs485PrioritySensors(SystemMode mode) {
+  switch (mode) {
+    case SystemMode::Cool:
+      return SHTManager_RS485::sensorBit(SHTManager_RS485::ROOM) |
+             SHTManager_RS485::sensorBit(SHTManager_RS485::BEFORE) |
+             SHTManager_RS485::sensorBit(SHTManager_RS485::AFTER);
+    case SystemMode::Regenerate:
+      return SHTManager_RS485::sensorBit(SHTManager_RS485::BEFORE) |
+             SHTManager_RS485::sensorBit(SHTManager_RS485::AFTER);
+    case SystemMode::Heat:
+    case SystemMode::Stop:
+      return SHTManager_RS485::sensorBit(SHTManager_RS485::ROOM);
+    case SystemMode::Experiment:
+      return 0x1F; // everything is logged
+    default:
+      return 0;    // Manual
+  }
+}
+
 // Helper function to calculate inner fan speed based on room temperature
 int calcInnerFansSpeedByRoomTemp(float roomTemp) {
   if(isnan(roomTemp)) {
-    logMessage("[calcInnerFansSpeedByRoomTemp] Room temp not available, using fallback value: 25°C");
+    logMessage(LogLevel::Warn, "[calcInnerFansSpeedByRoomTemp] Room temp not available, using fallback value: 25°C");
     roomTemp = 25.0; // Use 25°C as fallback - middle of the range
   }
 
@@ -727,7 +787,7 @@ int calcInnerFansSpeedByRoomTemp(float roomTemp) {
   // In any case, set max fans speed to 30%, for safety reasons (electrical and noise)
   percentage = constrain(percentage, 0, 30);
 
-  logMessage("[calcInnerFansSpeedByRoomTemp] Room temp: " + String(roomTemp, 1) + "°C → Fan speed: " + String(percentage) + "%");
+  logMessage(LogLevel::Debug, "[calcInnerFansSpeedByRoomTemp] Room temp: " + String(roomTemp, 1) + "°C → Fan speed: " + String(percentage) + "%");
   return percentage;
 }
 
@@ -739,7 +799,7 @@ void onInnerFans(int speedPercentage) {
   ledcWrite(FAN_INNER_CHANNEL, duty);
   currentInnerPWMSpeed = speedPercentage;
   
-  logMessage("[onInnerFans] Inner fans: " + String(speedPercentage) + "% (duty " + String(duty) + ")");
+  logMessage(LogLevel::Debug, "[onInnerFans] Inner fans: " + String(speedPercentage) + "% (duty " + String(duty) + ")");
 }
 
 // ========== update mode =============
@@ -754,7 +814,7 @@ void updateSystemMode() {
   SystemMode newMode = SystemMode::Stop;
   if (scheduleManager) {
     newMode = scheduleManager->getCurrentSystemMode();
-    logMessage("[UpdateSystemMode] ScheduleManager mode: " + SystemModeHelper::toString(newMode) + "; " + getCurrentScheduleInfo());
+    logMessage(LogLevel::Debug, "[UpdateSystemMode] ScheduleManager mode: " + SystemModeHelper::toString(newMode) + "; " + getCurrentScheduleInfo());
   } else {
     logMessage("[UpdateSystemMode] ScheduleManager not available, using default mode");
   }
@@ -766,9 +826,9 @@ void updateSystemMode() {
   }
 
   // Step 3: Get sensor data
-  float roomTemp = shtRS485Manager.getRoomTemp();
-  float beforeRH = shtRS485Manager.getBeforeRH();
-  float afterRH = shtRS485Manager.getAfterRH();
+  float roomTemp = sensorRegistry.value(roomTempId);
+  float beforeRH = sensorRegistry.value(beforeRHId);
+  float afterRH = sensorRegistry.value(afterRHId);
 
   // Step 4: Validate mode based on sensor data (if available)
   if (newMode == SystemMode::Cool) {
@@ -894,7 +954,7 @@ void updateSystemMode() {
 
   // Step 7: Handle special cases
   if (currentSystemMode != SystemMode::Stop && newMode == SystemMode::Stop) {
-    lastAfterHumidity = shtRS485Manager.getAfterRH();
+    lastAfterHumidity = sensorRegistry.value(afterRHId);
   }
 
   // Step 8: Call setSystemMode with all parameters
@@ -971,16 +1031,16 @@ void PrintSensors(){
   wateringBudget.printStatus("Drippers");
   sprinklersBudget.printStatus("Sprinklers");
 
-  // RS485 SHT31 sensors
-  Serial.println("RS485 SHT31 sensors:");
-  float ambiantTemp = shtRS485Manager.getAmbiantTemp();
-  float ambiantRH = shtRS485Manager.getAmbiantRH();
-  float beforeTemp = shtRS485Manager.getBeforeTemp();
-  float beforeRH = shtRS485Manager.getBeforeRH();
-  float afterTemp = shtRS485Manager.getAfterTemp();
-  float afterRH = shtRS485Manager.getAfterRH();
-  float roomTemp = shtRS485Manager.getRoomTemp();
-  float roomRH = shtRS485Manager.getRoomRH();
+  // Control sensors, from whichever bus serves each role
+  Serial.println("Control sensors:");
+  float ambiantTemp = sensorRegistry.value(ambiantTempId);
+  float ambiantRH = sensorRegistry.value(ambiantRHId);
+  float beforeTemp = sensorRegistry.value(beforeTempId);
+  float beforeRH = sensorRegistry.value(beforeRHId);
+  float afterTemp = sensorRegistry.value(afterTempId);
+  float afterRH = sensorRegistry.value(afterRHId);
+  float roomTemp = sensorRegistry.value(roomTempId);
+  float roomRH = sensorRegistry.value(roomRHId);
   
   Serial.print("Ambiant: Temp = " + (isnan(ambiantTemp) ? "N/A" : String(ambiantTemp)));
   Serial.println("; RH = " + (isnan(ambiantRH) ? "N/A" : String(ambiantRH)));
@@ -1027,36 +1087,65 @@ void setupWiFi(unsigned long timeoutMs = 10000) {
     if (WiFi.status() == WL_CONNECTED) {
         logMessage("[WiFi] Connected.");
     } else {
-        logMessage("[WiFi] Failed to connect. Continuing in offline mode.");
+        logMessage(LogLevel::Warn, "[WiFi] Failed to connect. Continuing in offline mode.");
         // Optionally disable WiFi to save power
         WiFi.mode(WIFI_OFF);
     }
 }
 
-// The method init NTP server and wait until the builtin 
-// RTC will get the current time from the net
-struct tm SetupTime() {
+// Set by the SNTP task when the system clock was synced from the net;
+// the RTC is updated from loop() so Wire1 is only used by one task
+volatile bool ntpSynced = false;
+
+// The method init NTP server. The sync itself runs in the background,
+// the system clock keeps running on the RTC time until it completes.
+void SetupTime() {
+    sntp_set_time_sync_notification_cb([](struct timeval* tv) { ntpSynced = true; });
     configTime(gmtOffset_sec, daylightOffset_sec, "pool.ntp.org", "time.nist.gov");
     logMessage("NTP configured");
+}
 
-    struct tm timeinfo;
-    const int maxRetries = 10;  // Try for 10 seconds max
-    int retries = 0;
-
-    while (!getLocalTime(&timeinfo) && retries < maxRetries) {
-        Serial.println("Failed to obtain time, retrying...");
-        retries++;
-        delay(1000);
-    }
+// Local time zone before NTP is configured (configTime() sets the same zone later).
+// The RTC keeps local time, so this must be set before restoring from it.
+void setupTimeZone() {
+    char tz[16];
+    snprintf(tz, sizeof(tz), "UTC%+ld", -(gmtOffset_sec + daylightOffset_sec) / 3600); // POSIX sign is inverted
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+// Restore the system clock from the RTC, so the schedule works before (or without) NTP
+void restoreTimeFromRTC() {
+    DateTime rtcNow = rtc.now();
+
+    // Fill timeInfo struct from RTC
+    struct tm timeInfo = {};
+    timeInfo.tm_year = rtcNow.year() - 1900;
+    timeInfo.tm_mon  = rtcNow.month() - 1;
+    timeInfo.tm_mday = rtcNow.day();
+    timeInfo.tm_hour = rtcNow.hour();
+    timeInfo.tm_min  = rtcNow.minute();
+    timeInfo.tm_sec  = rtcNow.second();
+    timeInfo.tm_isdst = -1;
+
+    struct timeval tv = {
+      .tv_sec = mktime(&timeInfo),
+      .tv_usec = 0
+    };
+    settimeofday(&tv, nullptr);
+    logMessage("[Time] System time restored from RTC.");
+    Serial.println(timeToString(timeInfo));
+}
 
-    if (retries >= maxRetries) {
-        logMessage("ERROR: Unable to set time from NTP. Using default time or RTC fallback.");
-        // Optional: you could set default values in timeinfo or handle it gracefully.
-    } else {
-        Serial.println("Time successfully set!");
-    }
+// Called from loop() after an NTP sync
+void syncRTCFromNTP() {
+    struct tm timeInfo;
+    if (!rtcReady || !getLocalTime(&timeInfo)) return;
 
-    return timeinfo;
+    rtc.adjust(DateTime(timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
+                        timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec));
+    logMessage("[RTC] RTC updated from NTP.");
+    Serial.println(timeToString(timeInfo));
 }
 
 void PrintPartitions() {
@@ -1071,43 +1160,58 @@ void PrintPartitions() {
 
 void sendTelemetry() {
   // ThingsBoard server
-  // RS485 SHT31 sensors
+  // RS485 SHT31 sensors - raw values; the filtered ones go out with the window statistics
   float val;
-  val = shtRS485Manager.getAmbiantTemp(); if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Ambiant_Temp", val);
+  val = shtRS485Manager.getRawTemp(SHTManager_RS485::AMBIANT); if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Ambiant_Temp", val);
     logToS3("RS485_Ambiant_Temp", "SHT31", "deg_c", val);
   }
-  val = shtRS485Manager.getAmbiantRH();   if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Ambiant_RH", val);
+  val = shtRS485Manager.getRawRH(SHTManager_RS485::AMBIANT);   if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Ambiant_RH", val);
     logToS3("RS485_Ambiant_RH", "SHT31", "rh", val);
   }
-  val = shtRS485Manager.getBeforeTemp();  if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Before_Temp", val);
+  val = shtRS485Manager.getRawTemp(SHTManager_RS485::BEFORE);  if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Before_Temp", val);
     logToS3("RS485_Before_Temp", "SHT31", "deg_c", val);
   }
-  val = shtRS485Manager.getBeforeRH();    if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Before_RH", val);
+  val = shtRS485Manager.getRawRH(SHTManager_RS485::BEFORE);    if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Before_RH", val);
     logToS3("RS485_Before_RH", "SHT31", "rh", val);
   }
-  val = shtRS485Manager.getAfterTemp();   if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_After_Temp", val);
+  val = shtRS485Manager.getRawTemp(SHTManager_RS485::AFTER);   if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_After_Temp", val);
     logToS3("RS485_After_Temp", "SHT31", "deg_c", val);
   }
-  val = shtRS485Manager.getAfterRH();     if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_After_RH", val);
+  val = shtRS485Manager.getRawRH(SHTManager_RS485::AFTER);     if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_After_RH", val);
     logToS3("RS485_After_RH", "SHT31", "rh", val);
   }
 
   // Room temperature and humidity
-  val = shtRS485Manager.getRoomTemp();    if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Room_Temp", val);
+  val = shtRS485Manager.getRawTemp(SHTManager_RS485::ROOM);    if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Room_Temp", val);
     logToS3("RS485_Room_Temp", "SHT31", "deg_c", val);
   }
-  val = shtRS485Manager.getRoomRH();      if (!isnan(val)) {
-    otaManager.sendTelemetry("RS485_Room_RH", val);
+  val = shtRS485Manager.getRawRH(SHTManager_RS485::ROOM);      if (!isnan(val)) {
+    otaManager.sendTelemetryIfChanged("RS485_Room_RH", val);
     logToS3("RS485_Room_RH", "SHT31", "rh", val);
   }
 
+  // RS485 bus health (per-address counters, latency histogram, utilization)
+  DynamicJsonDocument rs485Stats(3072);
+  shtRS485Manager.statsToJson(rs485Stats.to<JsonObject>());
+  otaManager.sendTelemetryBatch(rs485Stats);
+
+  // Every registry channel by role (filtered), including ones declared by configuration
+  DynamicJsonDocument sensorChannels(2048);
+  sensorRegistry.toJson(sensorChannels.to<JsonObject>());
+  otaManager.sendTelemetryBatch(sensorChannels);
+
+  // 10-minute window statistics (mean, min, max, trend) per RS485 channel
+  DynamicJsonDocument rs485Windows(3072);
+  shtRS485Manager.windowsToJson(rs485Windows.to<JsonObject>());
+  otaManager.sendTelemetryBatch(rs485Windows);
+
   // Send the system status code
   // The code is a 4 digit number:
   // First digit is the system mode: 1 = cooling; 2 = heating; 3 = regenerating; 0 = off
@@ -1120,27 +1224,30 @@ void sendTelemetry() {
   // The code is sent as a string, so it can be easily parsed by the server.
   // The code is also logged to S3 for long-term storage.
   logMode();
-  otaManager.sendTelemetry("Drippers_Actual", currentDrippersMode == WateringMode::On ? "Open" : "Close");
-  otaManager.sendTelemetry("Drippers_Slot", (int)(wateringBudget.getSlotDurationMs() / 1000));
-  otaManager.sendTelemetry("Dampers_Actual", currentAirMode == AirValveMode::Open ? "Open" : "Close");
-  otaManager.sendTelemetry("Sprinklers_Mode", desiredSprinklersMode == WateringMode::On ? "Open" : "Close");
-  otaManager.sendTelemetry("Sprinklers_Actual", currentSprinklersMode == WateringMode::On ? "Open" : "Close");
-  otaManager.sendTelemetry("Sprinklers_Slot", (int)(sprinklersBudget.getSlotDurationMs() / 1000));
+  otaManager.sendTelemetryIfChanged("Drippers_Actual", currentDrippersMode == WateringMode::On ? "Open" : "Close");
+  otaManager.sendTelemetryIfChanged("Dampers_Actual", currentAirMode == AirValveMode::Open ? "Open" : "Close");
+  otaManager.sendTelemetryIfChanged("Sprinklers_Mode", desiredSprinklersMode == WateringMode::On ? "Open" : "Close");
+  otaManager.sendTelemetryIfChanged("Sprinklers_Actual", currentSprinklersMode == WateringMode::On ? "Open" : "Close");
+
+  // Rarely changing facts are attributes, sent once per connection (or on change)
+  otaManager.sendAttributeOnce("Drippers_Slot", (int)(wateringBudget.getSlotDurationMs() / 1000));
+  otaManager.sendAttributeOnce("Sprinklers_Slot", (int)(sprinklersBudget.getSlotDurationMs() / 1000));
+  otaManager.sendAttributeOnce("fw_version_actual", CURRENT_FIRMWARE_VERSION);
 
   // Regeneration status telemetry
   if (currentSystemMode == SystemMode::Regenerate) {
-    otaManager.sendTelemetry("Regeneration_Status", "Active");
+    otaManager.sendTelemetryIfChanged("Regeneration_Status", "Active");
   } else {
-    otaManager.sendTelemetry("Regeneration_Status", "Inactive");
+    otaManager.sendTelemetryIfChanged("Regeneration_Status", "Inactive");
   }
 
   int fanAdcRaw = analogRead(PIN_FAN_INNER_ADC);
   float fanVoltage = fanAdcRaw * (3.3 / 4095.0);  // Adjust if voltage divider exists
-  otaManager.sendTelemetry("InnerFan_Voltage", fanVoltage);
+  otaManager.sendTelemetryIfChanged("InnerFan_Voltage", fanVoltage);
 
   int fanDuty = ledcRead(FAN_INNER_CHANNEL);
   float fanPercent = (fanDuty / 255.0f) * 100.0f;
-  otaManager.sendTelemetry("InnerFan_PWM", fanPercent);
+  otaManager.sendTelemetryIfChanged("InnerFan_PWM", fanPercent);
 
   
   // Send the current time
@@ -1158,11 +1265,14 @@ void sendTelemetry() {
     otaManager.sendTelemetry("OTA_System_Healthy", isSystemHealthy());
     otaManager.sendTelemetry("OTA_Last_Loop_Time", lastLoopTime);
   } else if (firmwareValidated) {
-    otaManager.sendTelemetry("OTA_Status", "VALIDATED");
-    otaManager.sendTelemetry("OTA_Firmware_Version", CURRENT_FIRMWARE_VERSION);
+    otaManager.sendTelemetryIfChanged("OTA_Status", "VALIDATED");
+    otaManager.sendAttributeOnce("OTA_Firmware_Version", CURRENT_FIRMWARE_VERSION);
   } else {
-    otaManager.sendTelemetry("OTA_Status", "NORMAL");
+    otaManager.sendTelemetryIfChanged("OTA_Status", "NORMAL");
   }
+
+  // Outbound MQTT queue health
+  otaManager.sendPublishStats();
   
   // S3 server
   delay(300);
@@ -1204,6 +1314,7 @@ void setSolenoidStatus(bool status) {
 
 void restartDevice() {
   logMessage("[restartDevice] Restarting ESP32...");
+  otaManager.flushPublishQueue();
   delay(1000); // Give time for log message to be sent
   ESP.restart();
 }
@@ -1286,6 +1397,141 @@ void setDrippersAutoMode(bool autoMode) {
   }
 } 
 
+// GPIOs the firmware drives itself; optional buses from systemConfig must stay off them
+bool isPinInUse(int pin) {
+  const int usedPins[] = {
+    PIN_RTC_SDA, PIN_RTC_SCL,
+    RS485_RX_PIN, RS485_TX_PIN, RS485_DE_RE_PIN, RS485_2_RX_PIN, RS485_2_TX_PIN, RS485_2_DE_RE_PIN,
+    PIN_PUMP_DRIPPERS, PIN_DAMPER, PIN_DAMPER_POWER, PIN_PUMP_SPRINKLERS, PIN_FAN_INNER1, PIN_FAN_INNER_ADC
+  };
+  for (int used : usedPins) {
+    if (used == pin) return true;
+  }
+  for (int used : fanPins) {
+    if (used == pin) return true;
+  }
+  return false;
+}
+
+// Why the SHT31 I2C buses can't be started next to what the firmware already drives.
+// As long as the RTC has Wire1 there is always a reason: I2C sensors need a board
+// (and firmware) with the RTC elsewhere.
+String i2cSensorsConflict() {
+  const int shtPins[] = { SDA_LEFT, SCL_LEFT, SDA_RIGHT, SCL_RIGHT };
+  for (int pin : shtPins) {
+    if (isPinInUse(pin)) return "GPIO " + String(pin) + " is already in use (RTC / RS485 / outputs)";
+  }
+  // SHTManager_I2C takes both I2C controllers, the RTC has the second one
+  return "I2C controller 1 (Wire1) drives the RTC";
+}
+
+// "28ff4a1c00000012" -> ROM code; false unless it's exactly 16 hex digits
+bool parseOneWireAddress(const char* hex, DallasManager::DeviceAddress& addr) {
+  if (!hex || strlen(hex) != 2 * addr.size()) return false;
+  for (size_t i = 0; i < addr.size(); ++i) {
+    char byteHex[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+    char* end;
+    addr[i] = (uint8_t)strtoul(byteHex, &end, 16);
+    if (*end) return false;
+  }
+  return true;
+}
+
+// DS18B20s on a 1-Wire bus, registry bus "onewire". A sensor's channel is its handle:
+// its position in the order sensors were first declared. The pin is taken from the
+// first configuration, changing it takes a reboot.
+void configureOneWire(JsonObjectConst oneWire) {
+  if (!dallasManager) {
+    if (!oneWire["pin"].is<int>()) {
+      logMessage(LogLevel::Warn, "[Config] oneWire: missing \"pin\"");
+      return;
+    }
+    if (isPinInUse(oneWire["pin"].as<int>())) {
+      logMessage(LogLevel::Warn, "[Config] oneWire ignored: GPIO " + String(oneWire["pin"].as<int>()) + " is already in use");
+      return;
+    }
+    dallasManager = new DallasManager(oneWire["pin"].as<int>());
+    dallasManager->begin();
+    oneWireSource = new DallasSensorSource(*dallasManager);
+    sensorRegistry.addSource(oneWireSource);
+  }
+  for (JsonObjectConst sensor : oneWire["sensors"].as<JsonArrayConst>()) {
+    const char* name = sensor["name"] | "";
+    DallasManager::DeviceAddress addr;
+    if (!*name || !parseOneWireAddress(sensor["addr"] | "", addr)) {
+      logMessage(LogLevel::Warn, "[Config] oneWire: skipping sensor without a name or a valid address");
+      continue;
+    }
+    DallasManager::Handle h = dallasManager->addSensor(name, addr, sensor["resolution"] | 12);
+    if (h != DallasManager::INVALID_HANDLE) logMessage("[Config] 1-Wire sensor '" + String(name) + "' on channel " + String(h));
+  }
+}
+
+// systemConfig shared attribute. Applied at boot from the attribute cache, and again
+// whenever ThingsBoard changes it. Until now the device only stored the raw JSON in
+// /config.json, so every key below is new and defined here - ThingsBoard has to
+// send them under these names. All are optional; a missing key keeps the current value:
+//   "autoMode": bool            system mode from the schedule (false = manual)
+//   "drippersAutoMode": bool    drippers follow the schedule (false = manual watering)
+//   "drippersSlotMin": int      drippers budget slot length, minutes (> 0)
+//   "sprinklersSlotMin": int    sprinklers budget slot length, minutes (> 0)
+//   "i2cSensors", "oneWire", "sensors", "rs485Buses", "rs485Filter": see below
+void applySystemConfig(JsonObjectConst config) {
+  if (config["drippersSlotMin"].is<int>()) {
+    int minutes = config["drippersSlotMin"];
+    if (minutes > 0) wateringBudget.setSlotDurationMs((unsigned long)minutes * 60 * 1000);
+  }
+  if (config["sprinklersSlotMin"].is<int>()) {
+    int minutes = config["sprinklersSlotMin"];
+    if (minutes > 0) sprinklersBudget.setSlotDurationMs((unsigned long)minutes * 60 * 1000);
+  }
+  if (config["drippersAutoMode"].is<bool>()) {
+    setDrippersAutoMode(config["drippersAutoMode"].as<bool>());
+  }
+  if (config["autoMode"].is<bool>()) {
+    setSystemAutoMode(config["autoMode"].as<bool>());
+  }
+  // Buses before "sensors", so channels can name them
+  // "i2cSensors": true - the SHT31 pairs on GPIO 4-7, bus "i2c", channels 0..3 = ambiant/before/after/room.
+  // Refused while their pins or I2C controllers are taken - on this board by the RTC and RS485 bus 0.
+  String i2cConflict = config["i2cSensors"].as<bool>() && !shtI2CManager ? i2cSensorsConflict() : String();
+  if (i2cConflict.length()) {
+    logMessage(LogLevel::Warn, "[Config] i2cSensors ignored: " + i2cConflict);
+  } else if (config["i2cSensors"].as<bool>() && !shtI2CManager) {
+    shtI2CManager = new SHTManager_I2C();
+    shtI2CManager->begin();
+    i2cSource = new I2CSensorSource(*shtI2CManager);
+    sensorRegistry.addSource(i2cSource);
+    logMessage("[Config] I2C sensors enabled");
+  }
+  // "oneWire": {"pin": 15, "sensors": [{"name": "tank", "addr": "28ff4a1c00000012", "resolution": 11}, ...]}
+  JsonObjectConst oneWire = config["oneWire"];
+  if (!oneWire.isNull()) configureOneWire(oneWire);
+  // "sensors": [{"role": "roof", "bus": "rs485", "channel": 4, "quantity": "temp", "intervalS": 60}, ...]
+  if (config["sensors"].is<JsonArrayConst>()) {
+    int added = sensorRegistry.addChannelsFromJson(config["sensors"].as<JsonArrayConst>());
+    logMessage("[Config] " + String(added) + " sensor channel(s) declared");
+  }
+  // "rs485Buses": {"roof": 1, ...} - the RS485 bus each role is wired to
+  JsonObjectConst rs485Buses = config["rs485Buses"];
+  if (!rs485Buses.isNull()) {
+    int moved = shtRS485Manager.moveRolesFromJson(rs485Buses);
+    if (moved) logMessage("[Config] " + String(moved) + " RS485 role(s) moved to another bus");
+  }
+  // "rs485Filter": {"median": 3, "emaAlpha": 0.4, "tempRatePerMin": 1.0, "rhRatePerMin": 5.0}
+  JsonObjectConst filter = config["rs485Filter"];
+  if (!filter.isNull()) {
+    FilterConfig temp = shtRS485Manager.getTempFilterConfig();
+    FilterConfig rh = shtRS485Manager.getRHFilterConfig();
+    if (filter["median"].is<int>()) temp.medianN = rh.medianN = filter["median"].as<int>();
+    if (filter["emaAlpha"].is<float>()) temp.emaAlpha = rh.emaAlpha = filter["emaAlpha"].as<float>();
+    if (filter["tempRatePerMin"].is<float>()) temp.maxRatePerMin = filter["tempRatePerMin"].as<float>();
+    if (filter["rhRatePerMin"].is<float>()) rh.maxRatePerMin = filter["rhRatePerMin"].as<float>();
+    shtRS485Manager.setFilterConfig(temp, rh);
+  }
+  logMessage("[Config] systemConfig applied");
+}
+
 void HandleManualControl();
 
 // ==============================================================================
@@ -1333,8 +1579,8 @@ bool isSystemHealthy() {
     return false;
   }
   
-  // Check if sensors are responding (basic check)
-  if (isnan(shtRS485Manager.getAmbiantTemp())) {
+  // Check if sensors are responding (basic check) - not before their first read attempt
+  if (shtRS485Manager.isWarmedUp() && isnan(sensorRegistry.value(ambiantTempId))) {
     Serial.println("[OTA-Health] Sensors not responding - system unhealthy");
     return false;
   }
@@ -1359,7 +1605,7 @@ void markFirmwareValid() {
         firmwareValidated = true;
         
         // Send validation confirmation to ThingsBoard
-        otaManager.sendTelemetry("fw_state", "VALIDATED");
+        otaManager.sendTelemetry("fw_state", "VALIDATED", PublishPriority::State);
         otaManager.sendTelemetry("fw_version_validated", CURRENT_FIRMWARE_VERSION);
         otaManager.sendTelemetry("fw_validation_time", (int)((millis() - firmwareStartTime) / 1000));
         
@@ -1378,8 +1624,9 @@ void triggerRollback(const String& reason) {
   Serial.printf("[OTA-Health] Triggering rollback: %s\n", reason.c_str());
   
   // Send rollback notification to ThingsBoard
-  otaManager.sendTelemetry("fw_state", "ROLLBACK");
-  otaManager.sendTelemetry("fw_rollback_reason", reason);
+  otaManager.sendTelemetry("fw_state", "ROLLBACK", PublishPriority::State);
+  otaManager.sendTelemetry("fw_rollback_reason", reason, PublishPriority::State);
+  otaManager.flushPublishQueue();
   
   // Mark current firmware as invalid to trigger rollback
   if (esp_ota_mark_app_invalid_rollback_and_reboot() == ESP_OK) {
@@ -1475,97 +1722,62 @@ void setup() {
 
   // Setup SHT sensors manager
   logMessage("[setup] SHT RS485 sensors manager:");
+  shtRS485Manager.addBus(rs485Bus0);
+  shtRS485Manager.addBus(rs485Bus1);
+  // Factory addresses - only used until discovery saved an address map (see 'shtdiscover')
   shtRS485Manager.setSensorAddr(SHTManager_RS485::AMBIANT, 4);
   shtRS485Manager.setSensorAddr(SHTManager_RS485::BEFORE, 5);
   shtRS485Manager.setSensorAddr(SHTManager_RS485::AFTER, 3);
   shtRS485Manager.setSensorAddr(SHTManager_RS485::ROOM, 1);
   shtRS485Manager.setSensorAddr(SHTManager_RS485::ROOF, 2);
-  shtRS485Manager.begin(4800);
-
-  // I'm still alive - Reset watchdog to prevent timeout
-  esp_task_wdt_reset();
-
-  Serial.println("[Setup] Connecting to WiFi");
-  setupWiFi();
-  if(WiFi.status() == WL_CONNECTED) {
-    int32_t rssi = WiFi.RSSI();
-    String message = "[WiFi] Current signal strength (RSSI): " + (String)rssi + "Bm";
-    if (rssi < -70) {
-      logMessage("[WiFI] Warning: Weak WiFi signal detected. Consider moving closer to the router.");
-    } else {
-      Serial.println("[WiFi] WiFi signal strength is good.");
-    }
-  }
-  
+  shtRS485Manager.beginWithAddressMap(4800);
+  // Sampling runs on core 0 (one task per bus), away from loop() (MQTT, S3 upload, OTA, console)
+  if (!shtRS485Manager.startTask(0)) {
+    logMessage(LogLevel::Error, "[setup] Failed to start RS485 acquisition task");
+  }
+
+  // Sensor channels by role; systemConfig "sensors" can add or re-point channels
+  sensorRegistry.addSource(&rs485Source);
+  for (int i = 0; i < SHTManager_RS485::sensorCount(); ++i) {
+    const char* role = SHTManager_RS485::roleName(static_cast<SHTManager_RS485::SensorIndex>(i));
+    sensorRegistry.addChannel(role, SensorQuantity::Temperature, &rs485Source, i, 60000);
+    sensorRegistry.addChannel(role, SensorQuantity::Humidity, &rs485Source, i, 60000);
+  }
+  ambiantTempId = sensorRegistry.find("ambiant", SensorQuantity::Temperature);
+  ambiantRHId = sensorRegistry.find("ambiant", SensorQuantity::Humidity);
+  beforeTempId = sensorRegistry.find("before", SensorQuantity::Temperature);
+  beforeRHId = sensorRegistry.find("before", SensorQuantity::Humidity);
+  afterTempId = sensorRegistry.find("after", SensorQuantity::Temperature);
+  afterRHId = sensorRegistry.find("after", SensorQuantity::Humidity);
+  roomTempId = sensorRegistry.find("room", SensorQuantity::Temperature);
+  roomRHId = sensorRegistry.find("room", SensorQuantity::Humidity);
 
   // I'm still alive - Reset watchdog to prevent timeout
   esp_task_wdt_reset();
 
-  // Step 1: Configure NTP and attempt to get current time
-  Serial.println("[Setup] Initializing TimeClient (NTP)");
-  struct tm timeInfo = SetupTime();  // This sets the internal time using NTP servers
-  timeClient = new TimeClient();
-  
-  // Initialize ScheduleManager
-  scheduleManager = new ScheduleManager(modeSchedule, timeClient);
-  logMessage("[Setup] ScheduleManager initialized");
-
-  // Step 2: Initialize RTC over I2C on custom pins (SDA = 7, SCL = 6)
+  // Local state first: clock from the RTC and the last known attributes from
+  // flash, so control starts right away and doesn't wait for WiFi / NTP / cloud.
   Serial.println("[Setup] Initializing RTC");
-  Wire1.begin(7, 6);  // Use secondary I2C bus
-  bool rtcReady = rtc.begin(&Wire1);
+  setupTimeZone();
+  Wire1.begin(PIN_RTC_SDA, PIN_RTC_SCL);  // Use secondary I2C bus
+  rtcReady = rtc.begin(&Wire1);
   if (!rtcReady) {
-    logMessage("[RTC] Failed to initialize RTC — will use NTP only if available.");
+    logMessage(LogLevel::Warn, "[RTC] Failed to initialize RTC — will use NTP only if available.");
   } else {
     logMessage("[RTC] RTC initialized successfully.");
-    rtc.adjust(DateTime(F(__DATE__), F(__TIME__))); // Optional: Set compile-time as fallback base
-  }
-
-  // Step 3: If NTP time was successfully obtained → set RTC from NTP
-  if (getLocalTime(&timeInfo)) {
-    Serial.println("[Time] Time retrieved from NTP.");
-    Serial.println(timeToString(timeInfo));
-
-    if (rtcReady) {
-      rtc.adjust(DateTime(timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday,
-                          timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec));
-      Serial.println("[RTC] RTC updated from NTP.");
-    }
-  } else {
-    logMessage("[Time] NTP unavailable. Trying to get time from RTC...");
-
-    // Step 4: Fallback to RTC if NTP fails
-    if (rtcReady) {
-      DateTime rtcNow = rtc.now();
-
-      // Fill timeInfo struct from RTC
-      timeInfo.tm_year = rtcNow.year() - 1900;
-      timeInfo.tm_mon  = rtcNow.month() - 1;
-      timeInfo.tm_mday = rtcNow.day();
-      timeInfo.tm_hour = rtcNow.hour();
-      timeInfo.tm_min  = rtcNow.minute();
-      timeInfo.tm_sec  = rtcNow.second();
-
-      // Set system time manually (if needed by your TimeClient or system)
-      struct timeval tv = {
-        .tv_sec = mktime(&timeInfo),
-        .tv_usec = 0
-      };
-      settimeofday(&tv, nullptr);
-      logMessage("[Time] System time restored from RTC.");
-      Serial.println(timeToString(timeInfo));
-    } else {
-      logMessage("[RTC] Failed to read time from RTC as well. Using default or previous time.");
+    if (rtc.lostPower()) {
+      logMessage(LogLevel::Warn, "[RTC] RTC lost power, setting compile time until NTP syncs");
+      rtc.adjust(DateTime(F(__DATE__), F(__TIME__))); // fallback base
     }
+    restoreTimeFromRTC();
   }
 
-  // I'm still alive - Reset watchdog to prevent timeout
-  esp_task_wdt_reset();
+  timeClient = new TimeClient();
 
-  Serial.print("[Setup] Initializing S3Log ");
-  dataLog = new S3Log("/log.txt", timeClient);
+  // Initialize ScheduleManager
+  scheduleManager = new ScheduleManager(modeSchedule, timeClient);
+  logMessage("[Setup] ScheduleManager initialized");
 
-  logMessage("[Setup] Initializing ThingsBoard");
   otaManager.setBeforeFirmwareUpdateCallback(off);
   otaManager.getFanSpeedFunc = getFanSpeed;
   otaManager.setFanSpeedFunc = setFanSpeed;
@@ -1590,6 +1802,42 @@ void setup() {
   otaManager.setDrippersAutoModeFunc = setDrippersAutoMode;
   otaManager.setInnerFansSpeedFunc = onInnerFans;
   otaManager.getInnerFansSpeedFunc = getInnerFansSpeed;
+  otaManager.applySystemConfigFunc = applySystemConfig;
+  otaManager.applyCachedAttributes();
+
+  updateSystemMode();
+  unsigned long firstControlMs = millis();
+  logMessage("[Setup] First control action after " + String(firstControlMs) + "ms");
+  otaManager.reportControlOutage(firstControlMs); // published once MQTT is up
+
+  // I'm still alive - Reset watchdog to prevent timeout
+  esp_task_wdt_reset();
+
+  Serial.println("[Setup] Connecting to WiFi");
+  setupWiFi();
+  if(WiFi.status() == WL_CONNECTED) {
+    int32_t rssi = WiFi.RSSI();
+    String message = "[WiFi] Current signal strength (RSSI): " + (String)rssi + "Bm";
+    if (rssi < -70) {
+      logMessage(LogLevel::Warn, "[WiFI] Warning: Weak WiFi signal detected. Consider moving closer to the router.");
+    } else {
+      Serial.println("[WiFi] WiFi signal strength is good.");
+    }
+  }
+  
+
+  // I'm still alive - Reset watchdog to prevent timeout
+  esp_task_wdt_reset();
+
+  // Configure NTP; the RTC is updated from loop() once it syncs
+  Serial.println("[Setup] Initializing NTP");
+  SetupTime();
+
+  Serial.print("[Setup] Initializing S3Log ");
+  dataLog = new S3Log("/log.txt", timeClient);
+
+  logMessage("[Setup] Initializing ThingsBoard");
+  logManager.setSink([](const JsonDocument& batch) { otaManager.sendLogBatch(batch); });
   otaManager.begin();
   otaManager.sendAttribute("fw_version_actual", CURRENT_FIRMWARE_VERSION);
 
@@ -1599,7 +1847,7 @@ void setup() {
   
   if (isFirstBootAfterOTA) {
     Serial.println("[OTA-Health] Starting firmware validation process...");
-    otaManager.sendTelemetry("fw_state", "VALIDATING");
+    otaManager.sendTelemetry("fw_state", "VALIDATING", PublishPriority::State);
     otaManager.sendTelemetry("fw_version_validating", CURRENT_FIRMWARE_VERSION);
   }
 
@@ -1625,7 +1873,24 @@ void loop() {
   unsigned long loopStartTime = millis();
   
   otaManager.tick();
-  shtRS485Manager.tick();
+  logManager.tick();
+  sensorRegistry.tick();
+  rs485Recorder.tick();
+  shtRS485Manager.setPrioritySensors(rs485PrioritySensors(currentSystemMode));
+
+  if (ntpSynced) {
+    ntpSynced = false;
+    syncRTCFromNTP();
+    if (scheduleManager) scheduleManager->invalidateCache(); // the clock may have jumped
+  }
+
+  // Setup decided the mode with unknown sensor inputs - decide again once they're in
+  static bool sensorsWarmedUp = false;
+  if (!sensorsWarmedUp && shtRS485Manager.isWarmedUp()) {
+    sensorsWarmedUp = true;
+    updateSystemMode();
+  }
+
   experimentManager.tick();
   tick();
 
@@ -1710,6 +1975,17 @@ void loop() {
   esp_task_wdt_reset(); // I'm still alive - Reset watchdog to prevent timeout
 }
 
+// RS485 bus for a commissioning command; only asks when there is more than one
+SHTManager_RS485& promptRS485Bus() {
+  int bus = 0;
+  if (shtRS485Manager.busCount() > 1) {
+    Serial.printf("Enter RS485 bus (0-%u): \n", shtRS485Manager.busCount() - 1);
+    while (!Serial.available()) delay(10);
+    bus = constrain(Serial.readStringUntil('\n').toInt(), 0, shtRS485Manager.busCount() - 1);
+  }
+  return *shtRS485Manager.bus(bus);
+}
+
 // ==============================================================================
 // ==============================================================================
 void HandleManualControl(){
@@ -1825,7 +2101,7 @@ void HandleManualControl(){
       int baudCode = Serial.readStringUntil('\n').toInt();
 
       // Set new address and baud
-      bool ok = shtRS485Manager.setSensorAddressAndBaud(oldAddr, newAddr, baudCode);
+      bool ok = promptRS485Bus().setSensorAddressAndBaud(oldAddr, newAddr, baudCode);
       if (ok) {
         Serial.println("Sensor address/baud updated successfully.");
       } else {
@@ -1839,15 +2115,133 @@ void HandleManualControl(){
       while (!Serial.available()) delay(10);
       int newBaud = Serial.readStringUntil('\n').toInt();
       if (newBaud == 2400 || newBaud == 4800 || newBaud == 9600) {
-        shtRS485Manager.begin(newBaud);
+        promptRS485Bus().begin(newBaud);
         Serial.printf("RS485 serial baud rate changed to %d.\n", newBaud);
       } else {
         Serial.println("Invalid baud rate. Allowed: 2400, 4800, 9600.");
       }
     }
     else if (input.equalsIgnoreCase("shtscan")) {  // SHT31 RS485 SCAN ==============================
+      SHTManager_RS485& bus = promptRS485Bus();
       Serial.println("Scanning RS485 bus at all common baud rates (2400, 4800, 9600)...");
-      shtRS485Manager.scanRS485AllBauds(RS485Serial);
+      bus.scanRS485AllBauds();
+    }
+    else if (input.equalsIgnoreCase("shtdiscover")) {  // SHT31 RS485 DISCOVERY + ADDRESS MAP ==============================
+      SHTManager_RS485& bus = promptRS485Bus();
+      Serial.println("Discovering RS485 sensors and saving the address map...");
+      bus.discoverAndAssign(true);
+      bus.printConfig();
+    }
+    else if (input.equalsIgnoreCase("shtrole")) {  // SHT31 RS485 ROLE ASSIGNMENT ==============================
+      Serial.println("Enter sensor role (0=ambiant, 1=before, 2=after, 3=room, 4=roof): ");
+      while (!Serial.available()) delay(10);
+      int role = Serial.readStringUntil('\n').toInt();
+
+      Serial.println("Enter sensor address (1-247): ");
+      while (!Serial.available()) delay(10);
+      int addr = Serial.readStringUntil('\n').toInt();
+
+      if (role >= SHTManager_RS485::AMBIANT && role <= SHTManager_RS485::ROOF && addr >= 1 && addr <= 247) {
+        if (shtRS485Manager.assignRole(static_cast<SHTManager_RS485::SensorIndex>(role), addr)) {
+          shtRS485Manager.printConfig();
+        }
+      } else {
+        Serial.println("Invalid role or address.");
+      }
+    }
+    else if (input.equalsIgnoreCase("shttune")) {  // SHT31 RS485 BAUD + GAP TUNING ==============================
+      SHTManager_RS485& bus = promptRS485Bus();
+      if (bus.requestTune()) {
+        Serial.println("Tuning RS485 baud rate and inter-frame gap in the background (this bus pauses sampling, up to ~1 min); results follow in the log");
+      } else {
+        Serial.println("RS485 acquisition task isn't running, can't tune.");
+      }
+    }
+    else if (input.equalsIgnoreCase("shtcapture")) {  // SHT31 RS485 FRAME CAPTURE ==============================
+      SHTManager_RS485& bus = promptRS485Bus();
+      Serial.println("Enter capture duration in seconds (0 = stop): ");
+      while (!Serial.available()) delay(10);
+      int seconds = Serial.readStringUntil('\n').toInt();
+
+      for (uint8_t b = 0; b < shtRS485Manager.busCount(); ++b) shtRS485Manager.bus(b)->setFrameSink(nullptr);
+      rs485Recorder.stop();
+      if (seconds > 0 && rs485Recorder.start(bus.getBusId(), bus.getBaud(), (unsigned long)seconds * 1000)) {
+        if (!bus.setFrameSink(&rs485Recorder)) rs485Recorder.stop();
+      }
+      rs485Recorder.printStatus();
+    }
+    else if (input.equalsIgnoreCase("shtcapdump")) {  // SHT31 RS485 CAPTURE AS HEX ==============================
+      rs485Recorder.dump();
+    }
+    else if (input.equalsIgnoreCase("shtbus")) {  // SHT31 RS485 ROLE -> BUS ==============================
+      Serial.println("Enter sensor role (0=ambiant, 1=before, 2=after, 3=room, 4=roof): ");
+      while (!Serial.available()) delay(10);
+      int role = Serial.readStringUntil('\n').toInt();
+
+      Serial.printf("Enter RS485 bus (0-%u): \n", shtRS485Manager.busCount() - 1);
+      while (!Serial.available()) delay(10);
+      int bus = Serial.readStringUntil('\n').toInt();
+
+      if (role >= SHTManager_RS485::AMBIANT && role <= SHTManager_RS485::ROOF &&
+          shtRS485Manager.moveRole(static_cast<SHTManager_RS485::SensorIndex>(role), bus)) {
+        shtRS485Manager.printConfig();
+      } else {
+        Serial.println("Invalid role or bus.");
+      }
+    }
+    else if (input.equalsIgnoreCase("shtmap")) {  // SHT31 RS485 ADDRESS MAP ==============================
+      shtRS485Manager.printConfig();
+    }
+    else if(input.equalsIgnoreCase("mqttstats")) { // MQTT QUEUE STATS =============================
+      otaManager.printPublishStats();
+    }
+    else if(input.equalsIgnoreCase("shtsched")) { // RS485 POLLING SCHEDULE =============================
+      shtRS485Manager.printSchedule();
+    }
+    else if(input.equalsIgnoreCase("sensors")) { // SENSOR REGISTRY =============================
+      sensorRegistry.printChannels();
+    }
+    else if(input.equalsIgnoreCase("shtfilter")) { // RS485 FILTERS (RAW VS FILTERED) =============================
+      shtRS485Manager.printFilters();
+    }
+    else if(input.equalsIgnoreCase("shthist")) { // RS485 WINDOW STATISTICS =============================
+      shtRS485Manager.printHistory();
+    }
+    else if(input.equalsIgnoreCase("shtstats")) { // RS485 BUS HEALTH =============================
+      shtRS485Manager.printStats();
+    }
+    else if(input.equalsIgnoreCase("otametrics")) { // OTA TRANSFER METRICS =============================
+      otaManager.printOtaMetrics();
+    }
+    else if(input.equalsIgnoreCase("attrcache")) { // CACHED SHARED ATTRIBUTES =============================
+      otaManager.printAttributeCache();
+    }
+    else if(input.equalsIgnoreCase("telecache")) { // DELTA TELEMETRY CACHE =============================
+      otaManager.printTelemetryCache();
+    }
+    else if(input.equalsIgnoreCase("protoschema")) { // TELEMETRY PROTO SCHEMA =============================
+      Serial.println(TelemetryProto::schema());
+    }
+    else if(input.equalsIgnoreCase("telebench")) { // TELEMETRY ENCODING BENCHMARK =============================
+      otaManager.benchmarkEncoding();
+    }
+    else if(input.equalsIgnoreCase("logstatus")) { // LOG PIPELINE STATUS =============================
+      logManager.printStatus();
+    }
+    else if(input.startsWith("loglevel")) { // LOG LEVEL FILTER =============================
+      // loglevel <module|*> <debug|info|warn|error|none>
+      String args = input.substring(8);
+      args.trim();
+      int space = args.lastIndexOf(' ');
+      LogLevel level;
+      if (space <= 0 || !LogManager::levelFromString(args.substring(space + 1), level)) {
+        Serial.println("Usage: loglevel <module|*> <debug|info|warn|error|none>");
+      } else {
+        String module = args.substring(0, space);
+        module.trim();
+        logManager.setModuleLevel(module, level);
+        Serial.printf("Log level for '%s' set to %s\n", module.c_str(), LogManager::levelToString(level));
+      }
     }
     else if(input.equalsIgnoreCase("debug")) { // Debug Mode =============================
       Serial.println("Debug Mode");
@@ -1971,7 +2365,7 @@ void HandleManualControl(){
       }
     }
          else {
-          Serial.println("No such command. use: print, stop, dampers, drip, sprink, reg, regeff, exp, otastatus, otarollback, otavalidate, regslot, schedule");
+          Serial.println("No such command. use: print, stop, dampers, drip, sprink, reg, regeff, exp, otastatus, otarollback, otavalidate, regslot, schedule, mqttstats, logstatus, loglevel, protoschema, telebench, telecache, attrcache, otametrics, shtsched, shtstats, shtdiscover, shtrole, shtbus, shtcapture, shtcapdump, shtmap, shttune, shthist, shtfilter, sensors");
      }
   }
 }
\ No newline at end of file
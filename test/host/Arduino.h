@@ -0,0 +1,109 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core and FreeRTOS that the sensor
+// headers use, so env:native builds SHTManager_RS485 and replays captures
+// through it. The manager takes its time from the transport's ModbusClock;
+// millis() / micros() / delay() here only serve the other headers.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+using std::isnan;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// ==== Time ====
+// Host time stands still except for delay()
+inline unsigned long& hostMillis() {
+    static unsigned long ms = 0;
+    return ms;
+}
+inline unsigned long millis() { return hostMillis(); }
+inline unsigned long micros() { return hostMillis() * 1000; }
+inline void delay(unsigned long ms) { hostMillis() += ms; }
+
+// ==== String ====
+class String {
+public:
+    String(const char* s = "") : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(float v, int decimals = 2) : String((double)v, decimals) {}
+    String(double v, int decimals = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        _s = buf;
+    }
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+
+    String& operator+=(const String& o) { _s += o._s; return *this; }
+    String& operator+=(const char* s) { _s += s; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b._s); }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator!=(const String& o) const { return _s != o._s; }
+
+private:
+    std::string _s;
+};
+
+// ==== Serial: log lines go to stdout ====
+// No format checking: the headers print uint32_t with %lu, which matches on the
+// ESP32 (unsigned long there) but not on a 64-bit host
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    int printf(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+    size_t print(const char* s) { return (size_t)::printf("%s", s); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t println(const char* s = "") { return (size_t)::printf("%s\n", s); }
+    size_t println(const String& s) { return println(s.c_str()); }
+};
+
+static HostSerial Serial;
+
+// ==== FreeRTOS ====
+// Single-threaded host: no mutex (the headers treat a null one as always held)
+// and no tasks - the test drives tick() itself.
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define pdFAIL  0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return nullptr; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t,
+                                          TaskHandle_t*, BaseType_t) {
+    return pdFAIL;
+}
@@ -0,0 +1,73 @@
+#pragma once
+// Host stand-in for LittleFS: files live in memory for the length of the test
+// run, enough for the address map and migration marker of SHTManager_RS485.
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class File {
+public:
+    File() {}
+    File(std::vector<uint8_t>* data, bool append) : _data(data) {
+        if (append) _pos = data->size();
+    }
+
+    explicit operator bool() const { return _data != nullptr; }
+
+    size_t size() const { return _data ? _data->size() : 0; }
+
+    size_t read(uint8_t* buf, size_t length) {
+        if (!_data || _pos >= _data->size()) return 0;
+        size_t n = std::min(length, _data->size() - _pos);
+        memcpy(buf, _data->data() + _pos, n);
+        _pos += n;
+        return n;
+    }
+
+    size_t write(const uint8_t* buf, size_t length) {
+        if (!_data) return 0;
+        if (_data->size() < _pos + length) _data->resize(_pos + length);
+        memcpy(_data->data() + _pos, buf, length);
+        _pos += length;
+        return length;
+    }
+
+    void close() { _data = nullptr; }
+
+private:
+    std::vector<uint8_t>* _data = nullptr;
+    size_t _pos = 0;
+};
+
+class HostFS {
+public:
+    bool begin(bool formatOnFail = false) { (void)formatOnFail; return true; }
+
+    File open(const char* path, const char* mode) {
+        if (mode[0] == 'r') {
+            std::map<std::string, std::vector<uint8_t>>::iterator it = _files.find(path);
+            return it == _files.end() ? File() : File(&it->second, false);
+        }
+        std::vector<uint8_t>& data = _files[path];
+        if (mode[0] == 'w') data.clear();
+        return File(&data, mode[0] == 'a');
+    }
+
+    bool exists(const char* path) const { return _files.count(path) != 0; }
+    bool remove(const char* path) { return _files.erase(path) != 0; }
+
+    bool rename(const char* from, const char* to) {
+        std::map<std::string, std::vector<uint8_t>>::iterator it = _files.find(from);
+        if (it == _files.end()) return false;
+        _files[to].swap(it->second);
+        _files.erase(it);
+        return true;
+    }
+
+private:
+    std::map<std::string, std::vector<uint8_t>> _files;
+};
+
+// One file system per test executable (each test suite is a single translation unit)
+static HostFS LittleFS;
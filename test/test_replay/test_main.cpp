@@ -0,0 +1,200 @@
+// Host replay of RS485 traffic through ModbusRtuClient and SHTManager_RS485
+// (pio test -e native). The capture is built here in the format
+// ModbusFrameRecorder writes; a field capture ('shtcapture' + 'shtcapdump',
+// xxd -r -p) replays the same way.
+
+#include <unity.h>
+#include <vector>
+#include "ModbusRtuClient.h"
+#include "ReplayTransport.h"
+#include "SHTManager_RS485.h"
+
+static const uint8_t ADDR = 4;               // the room sensor's factory address on the first bus
+static const uint32_t BAUD = 4800;
+static const unsigned long TIMEOUT_MS = 200;
+static const uint32_t INTERVAL_MS = 60000;   // the manager's default sampling interval
+static const uint32_t TICK_MS = 5;           // the acquisition task's period
+
+class CaptureBuilder {
+public:
+    explicit CaptureBuilder(uint32_t baud) : _bytes(ModbusCapture::HEADER_SIZE) {
+        ModbusCapture::encodeHeader(_bytes.data(), 0, baud);
+    }
+
+    // Read of RH + temperature at timeMs; the response (length 0 = no answer)
+    // completed elapsedUs after the request
+    void exchange(uint32_t timeMs, const uint8_t* response, uint8_t length, ModbusResult result, uint32_t elapsedUs) {
+        uint8_t request[8];
+        readRequest(request);
+        append(ModbusCaptureRecord::REQUEST, 0, timeMs, request, sizeof(request));
+        append(ModbusCaptureRecord::RESPONSE, (uint8_t)result, elapsedUs, response, length);
+    }
+
+    const uint8_t* data() const { return _bytes.data(); }
+    size_t size() const { return _bytes.size(); }
+
+    static void readRequest(uint8_t* frame) {
+        const uint8_t head[6] = { ADDR, ModbusRtuClient::FUNC_READ_INPUT_REGISTERS, 0x00, 0x00, 0x00, 0x02 };
+        for (int i = 0; i < 6; ++i) frame[i] = head[i];
+        uint16_t crc = ModbusRtuClient::crc16(frame, 6);
+        frame[6] = crc & 0xFF;
+        frame[7] = crc >> 8;
+    }
+
+    // Answer with RH and temperature in tenths
+    static void readResponse(uint8_t* frame, uint16_t rh, uint16_t temp) {
+        const uint8_t head[7] = { ADDR, ModbusRtuClient::FUNC_READ_INPUT_REGISTERS, 4,
+                                  (uint8_t)(rh >> 8), (uint8_t)(rh & 0xFF), (uint8_t)(temp >> 8), (uint8_t)(temp & 0xFF) };
+        for (int i = 0; i < 7; ++i) frame[i] = head[i];
+        uint16_t crc = ModbusRtuClient::crc16(frame, 7);
+        frame[7] = crc & 0xFF;
+        frame[8] = crc >> 8;
+    }
+
+private:
+    std::vector<uint8_t> _bytes;
+
+    void append(uint8_t kind, uint8_t result, uint32_t time, const uint8_t* frame, uint8_t length) {
+        size_t pos = _bytes.size();
+        _bytes.resize(pos + ModbusCapture::RECORD_HEADER_SIZE + length);
+        ModbusCapture::encodeRecord(&_bytes[pos], kind, result, time, frame, length);
+    }
+};
+
+// Two sampling rounds: a timeout, then a good answer; a corrupt answer, then a good one
+static CaptureBuilder fieldCapture() {
+    CaptureBuilder capture(BAUD);
+    uint8_t good1[9], good2[9], corrupt[9];
+    CaptureBuilder::readResponse(good1, 456, 234);
+    CaptureBuilder::readResponse(good2, 460, 239);
+    CaptureBuilder::readResponse(corrupt, 460, 239);
+    corrupt[4] ^= 0x10;
+    capture.exchange(0, nullptr, 0, ModbusResult::Timeout, TIMEOUT_MS * 1000);
+    capture.exchange(200, good1, sizeof(good1), ModbusResult::Success, 25000);
+    capture.exchange(INTERVAL_MS, corrupt, sizeof(corrupt), ModbusResult::CrcError, 25000);
+    capture.exchange(INTERVAL_MS + 30, good2, sizeof(good2), ModbusResult::Success, 25000);
+    return capture;
+}
+
+static void advanceTo(ManualClock& clock, uint32_t ms) {
+    if (ms > clock.nowMs()) clock.advanceMs(ms - clock.nowMs());
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_capture_is_valid() {
+    CaptureBuilder capture = fieldCapture();
+    ManualClock clock;
+    ReplayTransport replay(capture.data(), capture.size(), clock);
+    TEST_ASSERT_TRUE(replay.valid());
+    TEST_ASSERT_EQUAL_UINT32(BAUD, replay.capturedBaud());
+}
+
+void test_client_replays_timeout_and_crc_error() {
+    CaptureBuilder capture = fieldCapture();
+    ManualClock clock;
+    ReplayTransport replay(capture.data(), capture.size(), clock);
+    ModbusRtuClient client(replay);
+    client.begin(replay.capturedBaud());
+
+    TEST_ASSERT_EQUAL(ModbusResult::Timeout, client.readInputRegistersBlocking(ADDR, 0x0000, 2, TIMEOUT_MS));
+    // The timed-out attempt cost its timeout in bus time, no more
+    TEST_ASSERT_TRUE(clock.nowMs() >= TIMEOUT_MS);
+    TEST_ASSERT_TRUE(clock.nowMs() < TIMEOUT_MS + 100);
+    TEST_ASSERT_EQUAL(ModbusResult::Success, client.readInputRegistersBlocking(ADDR, 0x0000, 2, TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_UINT16(456, client.getRegister(0));
+    TEST_ASSERT_EQUAL_UINT16(234, client.getRegister(1));
+
+    advanceTo(clock, INTERVAL_MS);
+    TEST_ASSERT_EQUAL(ModbusResult::CrcError, client.readInputRegistersBlocking(ADDR, 0x0000, 2, TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ModbusResult::Success, client.readInputRegistersBlocking(ADDR, 0x0000, 2, TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_UINT16(460, client.getRegister(0));
+    TEST_ASSERT_EQUAL_UINT16(239, client.getRegister(1));
+
+    TEST_ASSERT_EQUAL_UINT32(4, replay.requests());
+    TEST_ASSERT_EQUAL_UINT32(0, replay.mismatches());
+    TEST_ASSERT_FALSE(replay.exhausted());
+}
+
+// The manager polls only the room sensor, at ADDR
+static void beginRoomOnly(SHTManager_RS485& rs485, ReplayTransport& replay) {
+    for (int i = SHTManager_RS485::AMBIANT; i <= SHTManager_RS485::ROOF; ++i) {
+        rs485.setSensorAddr(static_cast<SHTManager_RS485::SensorIndex>(i), 0);
+    }
+    rs485.setSensorAddr(SHTManager_RS485::ROOM, ADDR);
+    rs485.begin(replay.capturedBaud());
+}
+
+// Tick the manager until ms, as its acquisition task does
+static void runUntil(SHTManager_RS485& rs485, ManualClock& clock, uint32_t ms) {
+    while (clock.nowMs() < ms) {
+        rs485.tick();
+        clock.advanceMs(TICK_MS);
+    }
+}
+
+void test_manager_retries_recover_timeout_and_crc_error() {
+    CaptureBuilder capture = fieldCapture();
+    ManualClock clock;
+    ReplayTransport replay(capture.data(), capture.size(), clock);
+    SHTManager_RS485 rs485(replay);
+    beginRoomOnly(rs485, replay);
+
+    // First round: the timeout is retried, the second attempt answers
+    runUntil(rs485, clock, INTERVAL_MS / 2);
+    TEST_ASSERT_EQUAL_UINT32(2, replay.requests());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 23.4f, rs485.getRawTemp(SHTManager_RS485::ROOM));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 45.6f, rs485.getRawRH(SHTManager_RS485::ROOM));
+
+    // Next round one interval later: the corrupt answer is retried too
+    runUntil(rs485, clock, INTERVAL_MS + INTERVAL_MS / 2);
+    TEST_ASSERT_EQUAL_UINT32(4, replay.requests());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 23.9f, rs485.getRawTemp(SHTManager_RS485::ROOM));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 46.0f, rs485.getRawRH(SHTManager_RS485::ROOM));
+
+    const SHTManager_RS485::SensorStats& stats = rs485.getStats(SHTManager_RS485::ROOM);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.success);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.timeouts);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.crcErrors);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(0, replay.mismatches());
+    TEST_ASSERT_FALSE(replay.exhausted());
+}
+
+void test_manager_reading_expires_on_silent_bus() {
+    CaptureBuilder capture = fieldCapture();
+    ManualClock clock;
+    ReplayTransport replay(capture.data(), capture.size(), clock);
+    SHTManager_RS485 rs485(replay);
+    beginRoomOnly(rs485, replay);
+
+    runUntil(rs485, clock, INTERVAL_MS + INTERVAL_MS / 2);
+    SensorSnapshot snap;
+    rs485.getSnapshot(snap);
+    uint32_t lastGoodMs = snap.sensors[SHTManager_RS485::ROOM].readMs;
+    TEST_ASSERT_TRUE(lastGoodMs >= INTERVAL_MS);
+
+    // Past the end of the capture the sensor is silent: every round fails after
+    // all its retries, and the last reading ages until it expires
+    runUntil(rs485, clock, lastGoodMs + SHTManager_RS485::DATA_EXPIRY_MS - TICK_MS);
+    TEST_ASSERT_TRUE(replay.exhausted());
+    const SHTManager_RS485::SensorStats& stats = rs485.getStats(SHTManager_RS485::ROOM);
+    uint32_t silentRounds = stats.timeouts / SHTManager_RS485::MAX_RETRIES;
+    TEST_ASSERT_TRUE(silentRounds >= 2);
+    TEST_ASSERT_EQUAL_UINT32(1 + silentRounds * SHTManager_RS485::MAX_RETRIES, stats.timeouts);
+    TEST_ASSERT_FALSE(isnan(rs485.getTemp(SHTManager_RS485::ROOM)));
+
+    runUntil(rs485, clock, lastGoodMs + SHTManager_RS485::DATA_EXPIRY_MS);
+    TEST_ASSERT_TRUE(isnan(rs485.getTemp(SHTManager_RS485::ROOM)));
+    TEST_ASSERT_TRUE(isnan(rs485.getRawRH(SHTManager_RS485::ROOM)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_capture_is_valid);
+    RUN_TEST(test_client_replays_timeout_and_crc_error);
+    RUN_TEST(test_manager_retries_recover_timeout_and_crc_error);
+    RUN_TEST(test_manager_reading_expires_on_silent_bus);
+    return UNITY_END();
+}